@@ -29,6 +29,7 @@ _rgbasm_completions() {
 		[v]="verbose:normal"
 		[w]=":normal"
 		[b]="binary-digits:unk"
+		[c]="cache-dir:dir"
 		[D]="define:unk"
 		[g]="gfx-chars:unk"
 		[I]="include:dir"
@@ -39,6 +40,7 @@ _rgbasm_completions() {
 		[Q]="q-precision:unk"
 		[r]="recursion-depth:unk"
 		[s]="state:unk"
+		[t]="profile:glob-*.txt"
 		[W]="warning:warning"
 		[X]="max-errors:unk"
 	)
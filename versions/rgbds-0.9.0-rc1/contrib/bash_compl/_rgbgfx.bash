@@ -18,10 +18,12 @@ _rgbgfx_completions() {
 		[Z]="columns:normal"
 		[a]="attr-map:glob-*.attrmap"
 		[A]="auto-attr-map:normal"
+		[B]="batch:glob-*"
 		[b]="base-tiles:unk"
 		[c]="colors:unk"
 		[d]="depth:unk"
 		[i]="input-tileset:glob-*.2bpp"
+		[j]="jobs:unk"
 		[L]="slice:unk"
 		[N]="nb-tiles:unk"
 		[n]="nb-palettes:unk"
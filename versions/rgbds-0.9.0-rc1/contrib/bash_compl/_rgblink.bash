@@ -20,6 +20,7 @@ _rgblink_completions() {
 		[O]="overlay:glob-*.gb *.gbc *.sgb"
 		[o]="output:glob-*.gb *.gbc *.sgb"
 		[p]="pad:unk"
+		[T]="time-report:glob-*.json"
 	)
 	# Parse command-line up to current word
 	local opt_ena=true
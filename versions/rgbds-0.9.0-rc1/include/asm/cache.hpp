@@ -0,0 +1,26 @@
+/* SPDX-License-Identifier: MIT */
+
+#ifndef RGBDS_ASM_CACHE_HPP
+#define RGBDS_ASM_CACHE_HPP
+
+#include <string>
+
+void cache_SetDirectory(std::string const &path);
+// Must be called before the options are parsed, since parsing them modifies `argv`
+void cache_HashCommandLine(int argc, char *argv[]);
+// Compute the cache key from the command line and the main file's contents
+void cache_Init(std::string const &mainPath);
+// Prevent the current assembly from being stored, e.g. because its output is not reproducible
+void cache_Disable(char const *reason);
+void cache_UseCurrentTime();
+
+// Record that `path` was read as part of the assembly
+void cache_RecordFile(std::string const &path);
+// Record that `path` was looked up but did not exist, so creating it may change the output
+void cache_RecordMissing(std::string const &path);
+
+// If a valid entry exists, write its object file and dependencies, and return true
+bool cache_Replay();
+void cache_Store();
+
+#endif // RGBDS_ASM_CACHE_HPP
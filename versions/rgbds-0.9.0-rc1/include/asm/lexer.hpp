@@ -10,17 +10,6 @@
 #include <string>
 #include <vector>
 
-#include "either.hpp"
-#include "platform.hpp" // SSIZE_MAX
-
-// This value is a compromise between `LexerState` allocation performance when `mmap` works, and
-// buffering performance when it doesn't/can't (e.g. when piping a file into RGBASM).
-#define LEXER_BUF_SIZE 64
-// The buffer needs to be large enough for the maximum `lexerState->peek()` lookahead distance
-static_assert(LEXER_BUF_SIZE > 1, "Lexer buffer size is too small");
-// This caps the size of buffer reads, and according to POSIX, passing more than SSIZE_MAX is UB
-static_assert(LEXER_BUF_SIZE <= SSIZE_MAX, "Lexer buffer size is too large");
-
 enum LexerMode {
 	LEXER_NORMAL,
 	LEXER_RAW,
@@ -39,15 +28,22 @@ struct Expansion {
 	bool advance(); // Increment `offset`; return whether it then exceeds `contents`
 };
 
+struct TokenCache; // Defined in lexer.cpp
+struct CachedLine;
+
 struct ContentSpan {
 	std::shared_ptr<char[]> ptr;
 	size_t size;
+	// Tokens lexed from this span, which can be replayed when it gets lexed again
+	// (only set for MACRO and REPT bodies)
+	std::shared_ptr<TokenCache> tokenCache = nullptr;
 };
 
 struct ViewedContent {
 	ContentSpan span;  // Span of chars
 	size_t offset = 0; // Cursor into `span.ptr`
 
+	ViewedContent() = default;
 	ViewedContent(ContentSpan const &span_) : span(span_) {}
 	ViewedContent(std::shared_ptr<char[]> ptr, size_t size) : span({.ptr = ptr, .size = size}) {}
 
@@ -56,22 +52,6 @@ struct ViewedContent {
 	}
 };
 
-struct BufferedContent {
-	int fd;                        // File from which to read chars
-	char buf[LEXER_BUF_SIZE] = {}; // Circular buffer of chars
-	size_t offset = 0;             // Cursor into `buf`
-	size_t size = 0;               // Number of "fresh" chars in `buf`
-
-	BufferedContent(int fd_) : fd(fd_) {}
-	~BufferedContent();
-
-	void advance(); // Increment `offset` circularly, decrement `size`
-	void refill();  // Read from `fd` to fill `buf`
-
-private:
-	size_t readMore(size_t startIndex, size_t nbChars);
-};
-
 struct IfStackEntry {
 	bool ranIfBlock;       // Whether an IF/ELIF/ELSE block ran already
 	bool reachedElseBlock; // Whether an ELSE block ran already
@@ -98,7 +78,13 @@ struct LexerState {
 	bool expandStrings;
 	std::deque<Expansion> expansions; // Front is the innermost current expansion
 
-	Either<ViewedContent, BufferedContent> content;
+	CachedLine *replayedLine; // Line whose cached tokens are being replayed, if any
+	size_t replayIdx;         // Index of the next token to replay
+	CachedLine *recordedLine; // Line whose tokens are being cached, if any
+	bool tokenVaries;         // Whether the current token depends on more than the source text
+
+	// Files that cannot be `mmap`ed (e.g. pipes) are read into memory, so all content is viewed
+	ViewedContent content;
 
 	~LexerState();
 
@@ -148,7 +134,10 @@ void lexer_ReachELSEBlock();
 void lexer_CheckRecursionDepth();
 uint32_t lexer_GetLineNo();
 uint32_t lexer_GetColNo();
+uint64_t lexer_GetNbTokens(); // Total number of tokens lexed so far
 void lexer_DumpStringExpansions();
+// Prevents the token being lexed from being cached, e.g. because it caused a diagnostic
+void lexer_MarkTokenVarying();
 
 struct Capture {
 	uint32_t lineNo;
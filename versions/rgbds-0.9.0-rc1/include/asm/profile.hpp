@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: MIT */
+
+#ifndef RGBDS_ASM_PROFILE_HPP
+#define RGBDS_ASM_PROFILE_HPP
+
+#include <string>
+
+enum ProfileKind {
+	PROFILE_FILE,
+	PROFILE_MACRO,
+	PROFILE_REPT,
+};
+
+// Enable profiling; the summary is written to `path`, and the trace to `path` + ".json"
+void prof_SetFileName(std::string const &path);
+bool prof_IsEnabled();
+
+// Contexts must be entered and exited in a nested fashion, like the file stack's
+void prof_EnterContext(ProfileKind kind, std::string const &name);
+void prof_ExitContext();
+
+// Exits any contexts still open, then writes the summary and trace
+void prof_WriteReport();
+
+#endif // RGBDS_ASM_PROFILE_HPP
@@ -75,6 +75,7 @@ void sect_EndLoadSection();
 Section *sect_GetSymbolSection();
 uint32_t sect_GetSymbolOffset();
 uint32_t sect_GetOutputOffset();
+uint64_t sect_GetNbBytesEmitted(); // Total growth of all sections so far
 uint32_t sect_GetAlignBytes(uint8_t alignment, uint16_t offset);
 void sect_AlignPC(uint8_t alignment, uint16_t offset);
 
@@ -84,19 +84,19 @@ int32_t sym_GetRSValue();
 void sym_SetRSValue(int32_t value);
 uint32_t sym_GetConstantValue(std::string const &symName);
 // Find a symbol by exact name, bypassing expansion checks
-Symbol *sym_FindExactSymbol(std::string const &symName);
+Symbol *sym_FindExactSymbol(std::string_view symName);
 // Find a symbol, possibly scoped, by name
-Symbol *sym_FindScopedSymbol(std::string const &symName);
+Symbol *sym_FindScopedSymbol(std::string_view symName);
 // Find a scoped symbol by name; do not return `@` or `_NARG` when they have no value
-Symbol *sym_FindScopedValidSymbol(std::string const &symName);
+Symbol *sym_FindScopedValidSymbol(std::string_view symName);
 Symbol const *sym_GetPC();
 Symbol *sym_AddMacro(std::string const &symName, int32_t defLineNo, ContentSpan const &span);
 Symbol *sym_Ref(std::string const &symName);
 Symbol *sym_AddString(std::string const &symName, std::shared_ptr<std::string> value);
 Symbol *sym_RedefString(std::string const &symName, std::shared_ptr<std::string> value);
 void sym_Purge(std::string const &symName);
-bool sym_IsPurgedExact(std::string const &symName);
-bool sym_IsPurgedScoped(std::string const &symName);
+bool sym_IsPurgedExact(std::string_view symName);
+bool sym_IsPurgedScoped(std::string_view symName);
 void sym_Init(time_t now);
 
 // Functions to save and restore the current label scopes.
@@ -30,6 +30,7 @@ struct Options {
 	std::vector<std::array<std::optional<Rgba>, 4>> palSpec{};
 	uint8_t bitDepth = 2;       // -d
 	std::string inputTileset{}; // -i
+	uint16_t nbThreads = 1;     // -j
 	struct {
 		uint16_t left;
 		uint16_t top;
@@ -61,7 +62,8 @@ struct Options {
 	uint8_t maxOpaqueColors() const { return nbColorsPerPal - hasTransparentPixels; }
 };
 
-extern Options options;
+// Each thread converts one image at a time (see `-B`), so each has its own options
+extern thread_local Options options;
 
 /*
  * Prints the error count, and exits with failure
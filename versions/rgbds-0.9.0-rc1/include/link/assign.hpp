@@ -6,6 +6,7 @@
 #include <stdint.h>
 
 extern uint64_t nbSectionsToAssign;
+extern uint64_t nbFreeSpaceQueries;
 
 // Assigns all sections a slice of the address space
 void assign_AssignSections();
@@ -4,11 +4,12 @@
 #define RGBDS_LINK_OBJECT_HPP
 
 /*
- * Read an object (.o) file, and add its info to the data structures.
- * @param fileName A path to the object file to be read
- * @param i The ID of the file
+ * Read object (.o) files, and add their info to the data structures.
+ * The files are decoded in parallel, but added in order, as if they were read one by one.
+ * @param fileNames Paths to the object files to be read
+ * @param nbFiles How many files there are; the last one gets ID 0, the first one `nbFiles - 1`
  */
-void obj_ReadFile(char const *fileName, unsigned int i);
+void obj_ReadFiles(char const * const *fileNames, unsigned int nbFiles);
 
 /*
  * Sets up object file reading
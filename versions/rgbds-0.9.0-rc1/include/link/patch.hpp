@@ -3,6 +3,16 @@
 #ifndef RGBDS_LINK_PATCH_HPP
 #define RGBDS_LINK_PATCH_HPP
 
+#include <stdint.h>
+
+extern uint64_t nbRPNOpsEvaluated;
+
+/*
+ * Binds the symbols referenced by all assertions and patches, so that they need not be
+ * looked up by name every time that an expression is evaluated
+ */
+void patch_ResolveSymbols();
+
 /*
  * Checks all assertions
  * @return true if assertion failed
@@ -78,6 +78,11 @@ void sect_ForEach(void (*callback)(Section &));
  */
 void sect_AddSection(std::unique_ptr<Section> &&section);
 
+/*
+ * Concatenates the data of each fragmented section's fragments, once all of them are registered.
+ */
+void sect_MergeFragmentData();
+
 /*
  * Finds a section by its name.
  * @param name The name of the section to look for
@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: MIT */
+
+#ifndef RGBDS_LINK_TIMING_HPP
+#define RGBDS_LINK_TIMING_HPP
+
+// Enable timing; the report is written to `path`
+void timing_SetFileName(char const *path);
+bool timing_IsEnabled();
+
+// Opens the report file, so that failing to do so is reported before linking
+void timing_OpenReport();
+
+/*
+ * Ends the phase being timed, if any, and starts timing another one.
+ * @param name The phase's name in the report; must outlive the report
+ */
+void timing_StartPhase(char const *name);
+
+/*
+ * Ends the phase being timed, then writes the report.
+ * @param nbObjects How many object files were linked
+ */
+void timing_WriteReport(unsigned int nbObjects);
+
+#endif // RGBDS_LINK_TIMING_HPP
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: MIT */
+
+#ifndef RGBDS_PARALLEL_HPP
+#define RGBDS_PARALLEL_HPP
+
+#include <atomic>
+#include <stddef.h>
+#include <thread>
+#include <vector>
+
+// The number of threads to use when the user did not specify one
+static inline unsigned defaultNbThreads() {
+	unsigned nbThreads = std::thread::hardware_concurrency();
+	return nbThreads != 0 ? nbThreads : 1; // 0 means "unknown"
+}
+
+// Calls `func(i)` for each `i` in [0; count), spread across up to `nbThreads` threads.
+// Indexes are handed out in increasing order as threads become free, so uneven workloads still
+// balance out; however, calls may run concurrently and finish in any order.
+template<typename F>
+void parallelFor(size_t count, unsigned nbThreads, F const &func) {
+	if (nbThreads > count)
+		nbThreads = count;
+	if (nbThreads <= 1) {
+		for (size_t i = 0; i < count; i++)
+			func(i);
+		return;
+	}
+
+	std::atomic_size_t nextIndex = 0;
+	auto work = [&nextIndex, &count, &func]() {
+		for (size_t i; (i = nextIndex.fetch_add(1, std::memory_order_relaxed)) < count;)
+			func(i);
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(nbThreads - 1);
+	for (unsigned i = 1; i < nbThreads; i++)
+		threads.emplace_back(work);
+	work(); // The calling thread does its share of the work too
+	for (std::thread &thread : threads)
+		thread.join();
+}
+
+#endif // RGBDS_PARALLEL_HPP
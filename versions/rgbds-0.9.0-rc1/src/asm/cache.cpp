@@ -0,0 +1,364 @@
+/* SPDX-License-Identifier: MIT */
+
+#include "asm/cache.hpp"
+#include <sys/stat.h>
+
+#include <filesystem>
+#include <inttypes.h>
+#include <optional>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "error.hpp"
+#include "helpers.hpp" // Defer
+#include "platform.hpp" // S_ISDIR (stat macro)
+#include "version.hpp"
+
+#include "asm/fstack.hpp"
+#include "asm/main.hpp"
+#include "asm/output.hpp"
+
+// A cache entry is made of two files, both named after the entry's key:
+// - `<key>.o` is a copy of the object file that was output;
+// - `<key>.dep` is a manifest of everything else that the output depended on.
+// The key is a hash of the command line, working directory, and main file's contents.
+// The manifest starts with a header line, followed by lines of the form:
+// - `O <hash>`: the hash of `<key>.o`, to reject torn or corrupted writes;
+// - `M <hash> <path>`: the main file;
+// - `F <hash> <path>`: a file that was found, in the order they were looked up;
+// - `A <path>`: a file that was looked up, but did not exist.
+
+static char const *manifestHeader = "RGBASM cache manifest v1";
+
+static std::string cacheDir;
+static uint64_t commandLineHash;
+static bool reproducibleTime = false;
+
+static bool enabled = false;
+static std::string entryPath; // The entry's path, without any extension
+static std::string mainFileName;
+static std::vector<std::string> foundFiles;
+static std::vector<std::string> missingFiles;
+
+// 64-bit FNV-1a
+static constexpr uint64_t HASH_INIT = 0xCBF29CE484222325;
+
+static uint64_t hashBytes(uint64_t hash, void const *data, size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		hash ^= static_cast<uint8_t const *>(data)[i];
+		hash *= 0x100000001B3;
+	}
+	return hash;
+}
+
+static uint64_t hashString(uint64_t hash, char const *str) {
+	return hashBytes(hash, str, strlen(str) + 1); // Include the terminator as a separator
+}
+
+static std::optional<uint64_t> hashFile(std::string const &path) {
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file)
+		return std::nullopt;
+	Defer closeFile{[&] { fclose(file); }};
+
+	uint64_t hash = HASH_INIT;
+	static uint8_t buf[0x10000];
+	for (size_t nbRead; (nbRead = fread(buf, 1, sizeof(buf), file)) != 0;)
+		hash = hashBytes(hash, buf, nbRead);
+	if (ferror(file))
+		return std::nullopt;
+	return hash;
+}
+
+static bool readFile(std::string const &path, std::vector<uint8_t> &contents) {
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+	Defer closeFile{[&] { fclose(file); }};
+
+	contents.clear();
+	uint8_t buf[BUFSIZ];
+	for (size_t nbRead; (nbRead = fread(buf, 1, sizeof(buf), file)) != 0;)
+		contents.insert(contents.end(), buf, buf + nbRead);
+	return !ferror(file);
+}
+
+static bool writeFile(std::string const &path, void const *data, size_t size) {
+	// Write to a temporary file first, so that an interrupted write is never picked up
+	std::string tmpPath = path + ".tmp";
+	FILE *file = fopen(tmpPath.c_str(), "wb");
+	if (!file)
+		return false;
+	bool ok = fwrite(data, 1, size, file) == size;
+	ok = fclose(file) == 0 && ok;
+	// On Windows, `rename` does not replace existing files
+	remove(path.c_str());
+	return ok && rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+static std::string hashToHex(uint64_t hash) {
+	char hex[17];
+	snprintf(hex, sizeof(hex), "%016" PRIx64, hash);
+	return hex;
+}
+
+static std::optional<uint64_t> hexToHash(std::string const &str, size_t pos) {
+	if (str.length() < pos + 16)
+		return std::nullopt;
+	uint64_t hash = 0;
+	for (size_t i = pos; i < pos + 16; i++) {
+		char c = str[i];
+		if (c >= '0' && c <= '9')
+			hash = hash << 4 | (c - '0');
+		else if (c >= 'a' && c <= 'f')
+			hash = hash << 4 | (c - 'a' + 10);
+		else
+			return std::nullopt;
+	}
+	return hash;
+}
+
+static bool fileExists(std::string const &path) {
+	struct stat statBuf;
+	return stat(path.c_str(), &statBuf) == 0 && !S_ISDIR(statBuf.st_mode); // Reject directories
+}
+
+void cache_SetDirectory(std::string const &path) {
+	if (!cacheDir.empty())
+		warnx("Overriding cache directory %s", cacheDir.c_str());
+	cacheDir = path;
+	if (!cacheDir.empty() && cacheDir.back() != '/')
+		cacheDir += '/';
+	if (verbose)
+		printf("Cache directory %s\n", cacheDir.c_str());
+}
+
+void cache_HashCommandLine(int argc, char *argv[]) {
+	uint64_t hash = HASH_INIT;
+
+	hash = hashString(hash, get_package_version_string());
+	for (int i = 1; i < argc; i++)
+		hash = hashString(hash, argv[i]);
+
+	// Relative paths depend on the working directory
+	std::error_code ec;
+	hash = hashString(hash, std::filesystem::current_path(ec).string().c_str());
+
+	// If `SOURCE_DATE_EPOCH` is set, the time-related symbols only depend on it and the time zone
+	if (char const *sourceDateEpoch = getenv("SOURCE_DATE_EPOCH"); sourceDateEpoch) {
+		reproducibleTime = true;
+		hash = hashString(hash, sourceDateEpoch);
+		char const *timeZone = getenv("TZ");
+		hash = hashString(hash, timeZone ? timeZone : "");
+	}
+
+	commandLineHash = hash;
+}
+
+void cache_Init(std::string const &mainPath) {
+	if (cacheDir.empty())
+		return;
+
+	if (mainPath == "-") {
+		if (verbose)
+			printf("Not caching assembly: input is read from stdin\n");
+		return;
+	}
+	if (objectFileName.empty() || objectFileName == "-") {
+		if (verbose)
+			printf("Not caching assembly: no output file to cache\n");
+		return;
+	}
+
+	std::optional<uint64_t> mainHash = hashFile(mainPath);
+	if (!mainHash)
+		return; // Let the lexer report the error
+
+	uint64_t key = hashBytes(commandLineHash, &*mainHash, sizeof(*mainHash));
+	entryPath = cacheDir + hashToHex(key);
+	mainFileName = mainPath;
+	enabled = true;
+}
+
+void cache_Disable(char const *reason) {
+	if (!enabled)
+		return;
+
+	if (verbose)
+		printf("Not caching assembly: %s\n", reason);
+	enabled = false;
+}
+
+void cache_UseCurrentTime() {
+	if (!reproducibleTime)
+		cache_Disable("the current time was used without SOURCE_DATE_EPOCH");
+}
+
+void cache_RecordFile(std::string const &path) {
+	if (!enabled)
+		return;
+
+	if (path.find('\n') != std::string::npos)
+		cache_Disable("a file path contains a newline");
+	else
+		foundFiles.push_back(path);
+}
+
+void cache_RecordMissing(std::string const &path) {
+	if (!enabled)
+		return;
+
+	if (path.find('\n') != std::string::npos)
+		cache_Disable("a file path contains a newline");
+	else
+		missingFiles.push_back(path);
+}
+
+bool cache_Replay() {
+	if (!enabled)
+		return false;
+
+	std::vector<uint8_t> manifest;
+	if (!readFile(entryPath + ".dep", manifest))
+		return false;
+
+	std::unordered_map<std::string, uint64_t> hashes;
+	auto fileMatches = [&hashes](std::string const &path, uint64_t expected) {
+		if (auto search = hashes.find(path); search != hashes.end())
+			return search->second == expected;
+
+		std::optional<uint64_t> hash = hashFile(path);
+		if (!hash)
+			return false;
+		hashes.emplace(path, *hash);
+		return *hash == expected;
+	};
+
+	std::optional<uint64_t> objectHash;
+	std::vector<std::string> deps;
+	bool sawHeader = false;
+
+	for (size_t pos = 0; pos < manifest.size();) {
+		size_t end = pos;
+		while (end < manifest.size() && manifest[end] != '\n')
+			end++;
+		std::string line(manifest.begin() + pos, manifest.begin() + end);
+		pos = end + 1;
+
+		if (!sawHeader) {
+			if (line != manifestHeader)
+				return false;
+			sawHeader = true;
+			continue;
+		}
+
+		if (line.length() < 2 || line[1] != ' ')
+			return false;
+
+		switch (line[0]) {
+		case 'O':
+			objectHash = hexToHash(line, 2);
+			if (!objectHash)
+				return false;
+			break;
+
+		case 'M':
+		case 'F': {
+			std::optional<uint64_t> hash = hexToHash(line, 2);
+			if (!hash || line.length() < 19 || line[18] != ' ')
+				return false;
+			std::string path = line.substr(19);
+			if (!fileMatches(path, *hash))
+				return false;
+			if (line[0] == 'F')
+				deps.push_back(path);
+			break;
+		}
+
+		case 'A':
+			if (fileExists(line.substr(2)))
+				return false;
+			break;
+
+		default:
+			return false;
+		}
+	}
+
+	std::vector<uint8_t> object;
+	if (!objectHash || !readFile(entryPath + ".o", object)
+	    || hashBytes(HASH_INIT, object.data(), object.size()) != *objectHash)
+		return false;
+
+	if (verbose)
+		printf("Using cached object file %s.o\n", entryPath.c_str());
+
+	FILE *file = fopen(objectFileName.c_str(), "wb");
+	if (!file)
+		err("Failed to open object file '%s'", objectFileName.c_str());
+	Defer closeFile{[&] { fclose(file); }};
+	fwrite(object.data(), 1, object.size(), file);
+
+	for (std::string const &path : deps)
+		fstk_PrintDep(path);
+
+	return true;
+}
+
+void cache_Store() {
+	if (!enabled)
+		return;
+
+	std::vector<uint8_t> object;
+	if (!readFile(objectFileName, object)) {
+		warn("Failed to read back object file '%s' for caching", objectFileName.c_str());
+		return;
+	}
+
+	std::string manifest = manifestHeader;
+	manifest += '\n';
+
+	manifest += "O ";
+	manifest += hashToHex(hashBytes(HASH_INIT, object.data(), object.size()));
+	manifest += '\n';
+
+	auto appendFile = [&manifest](char type, std::string const &path) {
+		std::optional<uint64_t> hash = hashFile(path);
+		if (!hash)
+			return false;
+		manifest += type;
+		manifest += ' ';
+		manifest += hashToHex(*hash);
+		manifest += ' ';
+		manifest += path;
+		manifest += '\n';
+		return true;
+	};
+
+	if (!appendFile('M', mainFileName))
+		return;
+	for (std::string const &path : foundFiles) {
+		if (!appendFile('F', path))
+			return;
+	}
+	for (std::string const &path : missingFiles) {
+		manifest += "A ";
+		manifest += path;
+		manifest += '\n';
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(cacheDir, ec);
+
+	// Write the object before the manifest that refers to it
+	if (!writeFile(entryPath + ".o", object.data(), object.size())
+	    || !writeFile(entryPath + ".dep", manifest.data(), manifest.length()))
+		warn("Failed to write cache entry '%s'", entryPath.c_str());
+	else if (verbose)
+		printf("Cached object file as %s.o\n", entryPath.c_str());
+}
@@ -2,6 +2,7 @@
 
 #include "asm/charmap.hpp"
 
+#include <algorithm>
 #include <deque>
 #include <map>
 #include <stack>
@@ -19,12 +20,67 @@
 // Charmaps are stored using a structure known as "trie".
 // Essentially a tree, where each nodes stores a single character's worth of info:
 // whether there exists a mapping that ends at the current character,
+// and which nodes follow for each character.
+// Most nodes only have a few children, so those are kept as a list of edges sorted by character;
+// nodes with many children (typically the root) switch to a full 256-entry table instead.
+struct CharmapEdge {
+	uint8_t c;
+	// This MUST be an index and not a pointer, because pointers get invalidated by reallocation!
+	uint32_t nextIdx;
+};
+
+#define CHARMAP_MAX_EDGES 16 // Above this many children, a node uses a dense table
+
 struct CharmapNode {
 	std::vector<int32_t> value; // The mapped value, if there exists a mapping that ends here
-	// These MUST be indexes and not pointers, because pointers get invalidated by reallocation!
-	size_t next[256]; // Indexes of where to go next, 0 = nowhere
+	std::vector<CharmapEdge> edges; // Sorted by `c`; unused if `table` is not empty
+	std::vector<uint32_t> table;    // Indexes of where to go next, 0 = nowhere
 
 	bool isTerminal() const { return !value.empty(); }
+
+	size_t next(uint8_t c) const {
+		if (!table.empty())
+			return table[c];
+		for (CharmapEdge const &edge : edges) {
+			if (edge.c >= c)
+				return edge.c == c ? edge.nextIdx : 0;
+		}
+		return 0;
+	}
+
+	void setNext(uint8_t c, uint32_t nextIdx) {
+		if (!table.empty()) {
+			table[c] = nextIdx;
+			return;
+		}
+
+		auto it = std::lower_bound(RANGE(edges), c, [](CharmapEdge const &edge, uint8_t c_) {
+			return edge.c < c_;
+		});
+		assume(it == edges.end() || it->c != c); // Edges are never overwritten
+		edges.insert(it, {.c = c, .nextIdx = nextIdx});
+
+		if (edges.size() > CHARMAP_MAX_EDGES) {
+			table.resize(256, 0);
+			for (CharmapEdge const &edge : edges)
+				table[edge.c] = edge.nextIdx;
+			edges.clear();
+			edges.shrink_to_fit();
+		}
+	}
+
+	template<typename F>
+	void forEachNext(F callback) const {
+		if (!table.empty()) {
+			for (unsigned c = 0; c < 256; c++) {
+				if (uint32_t nextIdx = table[c]; nextIdx)
+					callback((uint8_t)c, nextIdx);
+			}
+		} else {
+			for (CharmapEdge const &edge : edges)
+				callback(edge.c, edge.nextIdx);
+		}
+	}
 };
 
 struct Charmap {
@@ -51,10 +107,9 @@ bool charmap_ForEach(
 			CharmapNode const &node = charmap.nodes[nodeIdx];
 			if (node.isTerminal())
 				mappings[nodeIdx] = mapping;
-			for (unsigned c = 0; c < 256; c++) {
-				if (size_t nextIdx = node.next[c]; nextIdx)
-					prefixes.push({nextIdx, mapping + (char)c});
-			}
+			node.forEachNext([&prefixes, &mapping](uint8_t c, size_t nextIdx) {
+				prefixes.push({nextIdx, mapping + (char)c});
+			});
 		}
 		mapFunc(charmap.name);
 		for (auto [nodeIdx, mapping] : mappings)
@@ -123,15 +178,13 @@ void charmap_Add(std::string const &mapping, std::vector<int32_t> &&value) {
 	size_t nodeIdx = 0;
 
 	for (char c : mapping) {
-		size_t &nextIdxRef = charmap.nodes[nodeIdx].next[(uint8_t)c];
-		size_t nextIdx = nextIdxRef;
+		size_t nextIdx = charmap.nodes[nodeIdx].next((uint8_t)c);
 
 		if (!nextIdx) {
 			// Switch to and zero-init the new node
-			nextIdxRef = charmap.nodes.size();
-			nextIdx = nextIdxRef;
-			// This may reallocate `charmap.nodes` and invalidate `nextIdxRef`,
-			// which is why we keep the actual value in `nextIdx`
+			nextIdx = charmap.nodes.size();
+			charmap.nodes[nodeIdx].setNext((uint8_t)c, nextIdx);
+			// This may reallocate `charmap.nodes`, which is why the edge is added beforehand
 			charmap.nodes.emplace_back();
 		}
 
@@ -151,7 +204,7 @@ bool charmap_HasChar(std::string const &input) {
 	size_t nodeIdx = 0;
 
 	for (char c : input) {
-		nodeIdx = charmap.nodes[nodeIdx].next[(uint8_t)c];
+		nodeIdx = charmap.nodes[nodeIdx].next((uint8_t)c);
 
 		if (!nodeIdx)
 			return false;
@@ -178,7 +231,7 @@ size_t charmap_ConvertNext(std::string_view &input, std::vector<int32_t> *output
 	size_t inputIdx = 0;
 
 	for (size_t nodeIdx = 0; inputIdx < input.length();) {
-		nodeIdx = charmap.nodes[nodeIdx].next[(uint8_t)input[inputIdx]];
+		nodeIdx = charmap.nodes[nodeIdx].next((uint8_t)input[inputIdx]);
 
 		if (!nodeIdx)
 			break;
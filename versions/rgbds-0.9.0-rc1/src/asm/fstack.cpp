@@ -15,9 +15,11 @@
 #include "linkdefs.hpp"
 #include "platform.hpp" // S_ISDIR (stat macro)
 
+#include "asm/cache.hpp"
 #include "asm/lexer.hpp"
 #include "asm/macro.hpp"
 #include "asm/main.hpp"
+#include "asm/profile.hpp"
 #include "asm/symbol.hpp"
 #include "asm/warning.hpp"
 
@@ -119,7 +121,7 @@ void fstk_SetPreIncludeFile(std::string const &path) {
 		printf("Pre-included filename %s\n", preIncludeName.c_str());
 }
 
-static void printDep(std::string const &path) {
+void fstk_PrintDep(std::string const &path) {
 	if (dependFile) {
 		fprintf(dependFile, "%s: %s\n", targetFileName.c_str(), path.c_str());
 		if (generatePhonyDeps)
@@ -135,14 +137,17 @@ static bool isValidFilePath(std::string const &path) {
 std::optional<std::string> fstk_FindFile(std::string const &path) {
 	for (std::string &incPath : includePaths) {
 		if (std::string fullPath = incPath + path; isValidFilePath(fullPath)) {
-			printDep(fullPath);
+			fstk_PrintDep(fullPath);
+			cache_RecordFile(fullPath);
 			return fullPath;
+		} else {
+			cache_RecordMissing(fullPath);
 		}
 	}
 
 	errno = ENOENT;
 	if (generatedMissingIncludes)
-		printDep(path);
+		fstk_PrintDep(path);
 	return std::nullopt;
 }
 
@@ -190,6 +195,7 @@ bool yywrap() {
 		return true;
 	}
 
+	prof_ExitContext();
 	contextStack.pop();
 	contextStack.top().lexerState.setAsCurrentState();
 
@@ -222,6 +228,7 @@ static bool newFileContext(std::string const &filePath, bool updateStateNow) {
 	    .uniqueIDStr = uniqueIDStr,
 	    .macroArgs = macroArgs,
 	});
+	prof_EnterContext(PROFILE_FILE, fileInfo->name());
 
 	return context.lexerState.setFileAsNextState(filePath, updateStateNow);
 }
@@ -258,6 +265,7 @@ static void newMacroContext(Symbol const &macro, std::shared_ptr<MacroArgs> macr
 	    .uniqueIDStr = std::make_shared<std::string>(), // Create a new, not-yet-generated ID
 	    .macroArgs = macroArgs,
 	});
+	prof_EnterContext(PROFILE_MACRO, macro.name);
 
 	context.lexerState.setViewAsNextState("MACRO", macro.getMacro(), macro.fileLine);
 }
@@ -283,6 +291,13 @@ static Context &newReptContext(int32_t reptLineNo, ContentSpan const &span, uint
 	    .uniqueIDStr = std::make_shared<std::string>(), // Create a new, not-yet-generated ID
 	    .macroArgs = oldContext.macroArgs,
 	});
+	if (prof_IsEnabled()) {
+		// REPT and FOR blocks are told apart by where they are
+		FileStackNode const *node = fileInfo->parent.get();
+		while (node->type == NODE_REPT)
+			node = node->parent.get();
+		prof_EnterContext(PROFILE_REPT, node->name() + "(" + std::to_string(reptLineNo) + ")");
+	}
 
 	context.lexerState.setViewAsNextState("REPT", span, reptLineNo);
 
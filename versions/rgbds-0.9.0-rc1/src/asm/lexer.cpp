@@ -11,6 +11,7 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <math.h>
+#include <optional>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,7 +20,9 @@
 	#include <unistd.h>
 #endif
 
+#include "either.hpp"
 #include "helpers.hpp" // assume, QUOTEDSTRLEN
+#include "platform.hpp" // SSIZE_MAX
 #include "util.hpp"
 
 #include "asm/fixpoint.hpp"
@@ -115,6 +118,26 @@ struct Token {
 	Token(int type_, std::string &&value_) : type(type_), value(value_) {}
 };
 
+// A token lexed from a MACRO or REPT body, along with the lexer state right after it
+struct CachedToken {
+	Token token;
+	size_t offset;
+	uint32_t lineDelta; // Relative to the line where the token starts
+	uint32_t colNo;
+	size_t macroArgScanDistance;
+};
+
+struct CachedLine {
+	bool complete = false; // Whether `tokens` go up to the line's `NEWLINE`
+	std::vector<CachedToken> tokens;
+};
+
+struct TokenCache {
+	// Keyed by the offset of each line's start within the body; an incomplete entry means that
+	// the line does not always lex the same way (e.g. due to macro args or interpolation)
+	std::unordered_map<size_t, CachedLine> lines;
+};
+
 struct CaseInsensitive {
 	// FNV-1a hash of an uppercased string
 	size_t operator()(std::string const &str) const {
@@ -357,6 +380,11 @@ void LexerState::clear(uint32_t lineNo_) {
 
 	expansions.clear();
 
+	replayedLine = nullptr;
+	replayIdx = 0;
+	recordedLine = nullptr;
+	tokenVaries = false;
+
 	lineNo = lineNo_; // Will be incremented at next line start
 }
 
@@ -400,12 +428,42 @@ void LexerState::setAsCurrentState() {
 	lexerState = this;
 }
 
+// Reads all of a file's contents, for when it cannot be mapped (e.g. a pipe)
+static std::optional<ContentSpan> readFile(int fd, std::string const &path, size_t sizeHint) {
+	auto buf = std::make_shared<std::vector<char>>();
+	size_t size = 0;
+
+	// Read in large chunks, growing the buffer geometrically
+	buf->resize(std::max(sizeHint + 1, (size_t)0x10000));
+	for (;;) {
+		if (size == buf->size())
+			buf->resize(size * 2);
+
+		size_t nbChars = std::min(buf->size() - size, (size_t)SSIZE_MAX);
+		ssize_t nbReadChars = read(fd, &(*buf)[size], nbChars);
+
+		if (nbReadChars == -1) {
+			error("Error while reading \"%s\": %s\n", path.c_str(), strerror(errno));
+			return std::nullopt;
+		}
+		if (nbReadChars == 0)
+			break;
+		size += nbReadChars;
+	}
+	buf->resize(size);
+
+	return ContentSpan{.ptr = std::shared_ptr<char[]>(buf, buf->data()), .size = size};
+}
+
 bool LexerState::setFileAsNextState(std::string const &filePath, bool updateStateNow) {
 	if (filePath == "-") {
 		path = "<stdin>";
-		content.emplace<BufferedContent>(STDIN_FILENO);
 		if (verbose)
 			printf("Opening stdin\n");
+		std::optional<ContentSpan> span = readFile(STDIN_FILENO, path, 0);
+		if (!span)
+			return false;
+		content = ViewedContent(*span);
 	} else {
 		struct stat statBuf;
 		if (stat(filePath.c_str(), &statBuf) != 0) {
@@ -426,7 +484,7 @@ bool LexerState::setFileAsNextState(std::string const &filePath, bool updateStat
 			// Try using `mmap` for better performance
 			if (char *mappingAddr = mapFile(fd, path, size); mappingAddr != nullptr) {
 				close(fd);
-				content.emplace<ViewedContent>(
+				content = ViewedContent(
 				    std::shared_ptr<char[]>(mappingAddr, FileUnmapDeleter(size)), size
 				);
 				if (verbose)
@@ -437,16 +495,20 @@ bool LexerState::setFileAsNextState(std::string const &filePath, bool updateStat
 
 		if (!isMmapped) {
 			// Sometimes mmap() fails or isn't available, so have a fallback
-			content.emplace<BufferedContent>(fd);
 			if (verbose) {
 				if (statBuf.st_size == 0) {
 					printf("File \"%s\" is empty\n", path.c_str());
 				} else {
 					printf(
-					    "File \"%s\" is opened; errno reports: %s\n", path.c_str(), strerror(errno)
+					    "File \"%s\" is read; errno reports: %s\n", path.c_str(), strerror(errno)
 					);
 				}
 			}
+			std::optional<ContentSpan> span = readFile(fd, path, statBuf.st_size);
+			close(fd);
+			if (!span)
+				return false;
+			content = ViewedContent(*span);
 		}
 	}
 
@@ -459,16 +521,14 @@ bool LexerState::setFileAsNextState(std::string const &filePath, bool updateStat
 }
 
 void LexerState::setViewAsNextState(char const *name, ContentSpan const &span, uint32_t lineNo_) {
-	path = name; // Used to report read errors in `.peek()`
-	content.emplace<ViewedContent>(span);
+	path = name;
+	content = ViewedContent(span);
 	clear(lineNo_);
 	lexerStateEOL = this;
 }
 
 void lexer_RestartRept(uint32_t lineNo) {
-	if (lexerState->content.holds<ViewedContent>()) {
-		lexerState->content.get<ViewedContent>().offset = 0;
-	}
+	lexerState->content.offset = 0;
 	lexerState->clear(lineNo);
 }
 
@@ -493,57 +553,6 @@ bool Expansion::advance() {
 	return offset > size();
 }
 
-BufferedContent::~BufferedContent() {
-	close(fd);
-}
-
-void BufferedContent::advance() {
-	assume(offset < LEXER_BUF_SIZE);
-	offset++;
-	if (offset == LEXER_BUF_SIZE)
-		offset = 0; // Wrap around if necessary
-	assume(size > 0);
-	size--;
-}
-
-void BufferedContent::refill() {
-	size_t target = LEXER_BUF_SIZE - size; // Aim: making the buf full
-
-	// Compute the index we'll start writing to
-	size_t startIndex = (offset + size) % LEXER_BUF_SIZE;
-
-	// If the range to fill passes over the buffer wrapping point, we need two reads
-	if (startIndex + target > LEXER_BUF_SIZE) {
-		size_t nbExpectedChars = LEXER_BUF_SIZE - startIndex;
-		size_t nbReadChars = readMore(startIndex, nbExpectedChars);
-
-		startIndex += nbReadChars;
-		if (startIndex == LEXER_BUF_SIZE)
-			startIndex = 0;
-
-		// If the read was incomplete, don't perform a second read
-		target -= nbReadChars;
-		if (nbReadChars < nbExpectedChars)
-			target = 0;
-	}
-	if (target != 0)
-		readMore(startIndex, target);
-}
-
-size_t BufferedContent::readMore(size_t startIndex, size_t nbChars) {
-	// This buffer overflow made me lose WEEKS of my life. Never again.
-	assume(startIndex + nbChars <= LEXER_BUF_SIZE);
-	ssize_t nbReadChars = read(fd, &buf[startIndex], nbChars);
-
-	if (nbReadChars == -1)
-		fatalerror("Error while reading \"%s\": %s\n", lexerState->path.c_str(), strerror(errno));
-
-	size += nbReadChars;
-
-	// `nbReadChars` cannot be negative, so it's fine to cast to `size_t`
-	return (size_t)nbReadChars;
-}
-
 void lexer_SetMode(LexerMode mode) {
 	lexerState->mode = mode;
 }
@@ -555,6 +564,8 @@ void lexer_ToggleStringExpansion(bool enable) {
 // Functions for the actual lexer to obtain characters
 
 static void beginExpansion(std::shared_ptr<std::string> str, std::optional<std::string> name) {
+	lexerState->tokenVaries = true;
+
 	if (name)
 		lexer_CheckRecursionDepth();
 
@@ -652,6 +663,8 @@ static uint32_t readBracketedMacroArgNum() {
 }
 
 static std::shared_ptr<std::string> readMacroArg(char name) {
+	lexerState->tokenVaries = true;
+
 	if (name == '@') {
 		auto str = fstk_GetUniqueIDStr();
 		if (!str) {
@@ -710,18 +723,8 @@ int LexerState::peekChar() {
 			return (uint8_t)(*exp.contents)[exp.offset];
 	}
 
-	if (content.holds<ViewedContent>()) {
-		auto &view = content.get<ViewedContent>();
-		if (view.offset < view.span.size)
-			return (uint8_t)view.span.ptr[view.offset];
-	} else {
-		auto &cbuf = content.get<BufferedContent>();
-		if (cbuf.size == 0)
-			cbuf.refill();
-		assume(cbuf.offset < LEXER_BUF_SIZE);
-		if (cbuf.size > 0)
-			return (uint8_t)cbuf.buf[cbuf.offset];
-	}
+	if (content.offset < content.span.size)
+		return (uint8_t)content.span.ptr[content.offset];
 
 	// If there aren't enough chars, give up
 	return EOF;
@@ -740,18 +743,8 @@ int LexerState::peekCharAhead() {
 		distance -= exp.size() - exp.offset;
 	}
 
-	if (content.holds<ViewedContent>()) {
-		auto &view = content.get<ViewedContent>();
-		if (view.offset + distance < view.span.size)
-			return (uint8_t)view.span.ptr[view.offset + distance];
-	} else {
-		auto &cbuf = content.get<BufferedContent>();
-		assume(distance < LEXER_BUF_SIZE);
-		if (cbuf.size <= distance)
-			cbuf.refill();
-		if (cbuf.size > distance)
-			return (uint8_t)cbuf.buf[(cbuf.offset + distance) % LEXER_BUF_SIZE];
-	}
+	if (content.offset + distance < content.span.size)
+		return (uint8_t)content.span.ptr[content.offset + distance];
 
 	// If there aren't enough chars, give up
 	return EOF;
@@ -829,11 +822,7 @@ restart:
 	} else {
 		// Advance within the file contents
 		lexerState->colNo++;
-		if (lexerState->content.holds<ViewedContent>()) {
-			lexerState->content.get<ViewedContent>().offset++;
-		} else {
-			lexerState->content.get<BufferedContent>().advance();
-		}
+		lexerState->content.offset++;
 	}
 }
 
@@ -851,6 +840,70 @@ static void handleCRLF(int c) {
 		shiftChar();
 }
 
+// When expansions are disabled and none is active, and no capture needs to copy chars, the
+// file's contents can be scanned in bulk instead of going through `peek()` and `shiftChar()`.
+// These return the chars that remain in the file contents, or an empty range if they can't be
+// scanned directly.
+static std::pair<char const *, char const *> directlyScannableChars() {
+	if (!lexerState->disableMacroArgs || !lexerState->disableInterpolation
+	    || !lexerState->expansions.empty() || lexerState->captureBuf)
+		return {nullptr, nullptr};
+
+	ViewedContent const &view = lexerState->content;
+	if (view.offset >= view.span.size)
+		return {nullptr, nullptr};
+	return {&view.span.ptr[view.offset], &view.span.ptr[view.span.size]};
+}
+
+// Equivalent to calling `shiftChar()` `nbChars` times on chars that were directly scanned
+static void shiftCharsDirectly(size_t nbChars) {
+	if (nbChars == 0)
+		return;
+
+	if (lexerState->capturing)
+		lexerState->captureSize += nbChars;
+	lexerState->macroArgScanDistance = 0; // Expansions are disabled, so nothing was scanned ahead
+	lexerState->colNo += nbChars;
+	lexerState->content.offset += nbChars;
+}
+
+// Skips chars until the next newline or EOF
+static void skipToLineEnd() {
+	auto [start, end] = directlyScannableChars();
+	if (start == end)
+		return;
+
+	char const *lf = (char const *)memchr(start, '\n', end - start);
+	if (lf)
+		end = lf;
+	char const *cr = (char const *)memchr(start, '\r', end - start);
+	shiftCharsDirectly((cr ? cr : end) - start);
+}
+
+// Skips chars that cannot end the current line or block comment
+static void skipBlockCommentChars() {
+	auto [start, end] = directlyScannableChars();
+	char const *ptr = start;
+
+	for (; ptr != end; ptr++) {
+		if (char c = *ptr; c == '*' || c == '/' || c == '\r' || c == '\n')
+			break;
+	}
+	shiftCharsDirectly(ptr - start);
+}
+
+// Skips chars that cannot end the current line, nor escape a newline
+static void skipSkippedLineChars() {
+	auto [start, end] = directlyScannableChars();
+	char const *ptr = start;
+
+	for (; ptr != end; ptr++) {
+		if (char c = *ptr; c == '\\' || c == '\r' || c == '\n')
+			break;
+	}
+	shiftCharsDirectly(ptr - start);
+}
+
 static auto scopedDisableExpansions() {
 	lexerState->disableMacroArgs = true;
 	lexerState->disableInterpolation = true;
@@ -870,6 +923,12 @@ uint32_t lexer_GetColNo() {
 	return lexerState->colNo;
 }
 
+static uint64_t nbTokens = 0;
+
+uint64_t lexer_GetNbTokens() {
+	return nbTokens;
+}
+
 void lexer_DumpStringExpansions() {
 	if (!lexerState)
 		return;
@@ -881,11 +940,17 @@ void lexer_DumpStringExpansions() {
 	}
 }
 
+void lexer_MarkTokenVarying() {
+	if (lexerState)
+		lexerState->tokenVaries = true;
+}
+
 // Functions to discard non-tokenized characters
 
 static void discardBlockComment() {
 	Defer reenableExpansions = scopedDisableExpansions();
 	for (;;) {
+		skipBlockCommentChars();
 		int c = nextChar();
 
 		switch (c) {
@@ -920,6 +985,7 @@ static void discardBlockComment() {
 static void discardComment() {
 	Defer reenableExpansions = scopedDisableExpansions();
 	for (;; shiftChar()) {
+		skipToLineEnd();
 		int c = peek();
 
 		if (c == EOF || c == '\r' || c == '\n')
@@ -954,6 +1020,8 @@ static void discardLineContinuation() {
 static std::string readAnonLabelRef(char c) {
 	uint32_t n = 0;
 
+	lexerState->tokenVaries = true; // Depends on the anonymous labels defined so far
+
 	// We come here having already peeked at one char, so no need to do it again
 	do {
 		shiftChar();
@@ -990,6 +1058,8 @@ static uint32_t readFractionalPart(uint32_t integer) {
 		READFRACTIONALPART_PRECISION_DIGITS,
 	} state = READFRACTIONALPART_DIGITS;
 
+	lexerState->tokenVaries = true; // Depends on the fixed-point precision option
+
 	for (;; shiftChar()) {
 		int c = peek();
 
@@ -1046,6 +1116,8 @@ char binDigits[2];
 static uint32_t readBinaryNumber() {
 	uint32_t value = 0;
 
+	lexerState->tokenVaries = true; // Depends on the binary digits option
+
 	for (;; shiftChar()) {
 		int c = peek();
 		int bit;
@@ -1104,6 +1176,8 @@ static uint32_t readGfxConstant() {
 	uint32_t bitPlaneLower = 0, bitPlaneUpper = 0;
 	uint8_t width = 0;
 
+	lexerState->tokenVaries = true; // Depends on the graphics digits option
+
 	for (;; shiftChar()) {
 		int c = peek();
 		uint32_t pixel;
@@ -1184,6 +1258,8 @@ static Token readIdentifier(char firstChar, bool raw) {
 // Functions to read strings
 
 static std::shared_ptr<std::string> readInterpolation(size_t depth) {
+	lexerState->tokenVaries = true;
+
 	if (depth > maxRecursionDepth)
 		fatalerror("Recursion limit (%zu) exceeded\n", maxRecursionDepth);
 
@@ -1764,6 +1840,7 @@ static Token yylex_NORMAL() {
 			return Token(T_(OP_AND));
 
 		case '%': // Either %=, MOD, or a binary constant
+			lexerState->tokenVaries = true; // Which one depends on the binary digits option
 			c = peek();
 			if (c == '=') {
 				shiftChar();
@@ -1823,10 +1900,15 @@ static Token yylex_NORMAL() {
 			if (startsIdentifier(c)) {
 				Token token = readIdentifier(c, raw);
 
-				// An ELIF after a taken IF needs to not evaluate its condition
-				if (token.type == T_(POP_ELIF) && lexerState->lastToken == T_(NEWLINE)
-				    && lexer_GetIFDepth() > 0 && lexer_RanIFBlock() && !lexer_ReachedELSEBlock())
-					return yylex_SKIP_TO_ENDC();
+				if (token.type == T_(POP_ELIF)) {
+					// Whether an ELIF is skipped depends on its IF, not only on the source text
+					lexerState->tokenVaries = true;
+
+					// An ELIF after a taken IF needs to not evaluate its condition
+					if (lexerState->lastToken == T_(NEWLINE) && lexer_GetIFDepth() > 0
+					    && lexer_RanIFBlock() && !lexer_ReachedELSEBlock())
+						return yylex_SKIP_TO_ENDC();
+				}
 
 				// If a keyword, don't try to expand
 				if (token.type != T_(ID) && token.type != T_(LOCAL_ID))
@@ -2091,6 +2173,7 @@ static Token skipIfBlock(bool toEndc) {
 
 		// Read chars until EOL
 		do {
+			skipSkippedLineChars();
 			int c = nextChar();
 
 			if (c == EOF) {
@@ -2171,6 +2254,7 @@ static Token yylex_SKIP_TO_ENDR() {
 
 		// Read chars until EOL
 		do {
+			skipSkippedLineChars();
 			int c = nextChar();
 
 			if (c == EOF) {
@@ -2192,6 +2276,83 @@ static Token yylex_SKIP_TO_ENDR() {
 	}
 }
 
+// Token caching, so that MACRO and REPT bodies are not lexed anew each time they are run
+
+static bool canUseTokenCache() {
+	return lexerState->content.span.tokenCache && lexerState->mode == LEXER_NORMAL
+	       && lexerState->expansions.empty() && !lexerState->capturing;
+}
+
+static void stopRecordingLine() {
+	// Leaving the line incomplete prevents it from ever being recorded or replayed again
+	lexerState->recordedLine->tokens.clear();
+	lexerState->recordedLine = nullptr;
+}
+
+static void beginCachedLine() {
+	lexerState->replayedLine = nullptr;
+	if (lexerState->recordedLine)
+		stopRecordingLine();
+	if (!canUseTokenCache())
+		return;
+
+	auto [lineIt, inserted] =
+	    lexerState->content.span.tokenCache->lines.try_emplace(lexerState->content.offset);
+	if (inserted) {
+		lexerState->recordedLine = &lineIt->second;
+	} else if (lineIt->second.complete) {
+		lexerState->replayedLine = &lineIt->second;
+		lexerState->replayIdx = 0;
+	}
+}
+
+static bool replayCachedToken(Token &token) {
+	if (!canUseTokenCache()) {
+		lexerState->replayedLine = nullptr;
+		return false;
+	}
+
+	CachedToken const &cached = lexerState->replayedLine->tokens[lexerState->replayIdx];
+	// A symbol may have been defined as an EQUS since the token was recorded
+	if ((cached.token.type == T_(ID) || cached.token.type == T_(LABEL))
+	    && lexerState->expandStrings) {
+		Symbol const *sym = sym_FindExactSymbol(cached.token.value.get<std::string>());
+
+		if (sym && sym->type == SYM_EQUS) {
+			lexerState->replayedLine = nullptr;
+			return false;
+		}
+	}
+
+	token = cached.token;
+	lexerState->content.offset = cached.offset;
+	lexerState->lineNo += cached.lineDelta;
+	lexerState->colNo = cached.colNo;
+	lexerState->macroArgScanDistance = cached.macroArgScanDistance;
+	if (++lexerState->replayIdx == lexerState->replayedLine->tokens.size())
+		lexerState->replayedLine = nullptr;
+	return true;
+}
+
+static void recordCachedToken(Token const &token, uint32_t lineNo) {
+	if (lexerState->tokenVaries || !canUseTokenCache() || token.type == T_(YYEOF)) {
+		stopRecordingLine();
+		return;
+	}
+
+	lexerState->recordedLine->tokens.push_back({
+	    .token = token,
+	    .offset = lexerState->content.offset,
+	    .lineDelta = lexerState->lineNo - lineNo,
+	    .colNo = lexerState->colNo,
+	    .macroArgScanDistance = lexerState->macroArgScanDistance,
+	});
+	if (token.type == T_(NEWLINE)) {
+		lexerState->recordedLine->complete = true;
+		lexerState->recordedLine = nullptr;
+	}
+}
+
 yy::parser::symbol_type yylex() {
 	if (lexerState->atLineStart && lexerStateEOL) {
 		lexerState = lexerStateEOL;
@@ -2210,7 +2371,20 @@ yy::parser::symbol_type yylex() {
 	    yylex_SKIP_TO_ENDC,
 	    yylex_SKIP_TO_ENDR,
 	};
-	Token token = lexerModeFuncs[lexerState->mode]();
+	if (lexerState->atLineStart)
+		beginCachedLine();
+
+	Token token;
+	if (!lexerState->replayedLine || !replayCachedToken(token)) {
+		if (lexerState->recordedLine && !canUseTokenCache())
+			stopRecordingLine();
+		lexerState->tokenVaries = false;
+
+		uint32_t lineNo = lexerState->lineNo;
+		token = lexerModeFuncs[lexerState->mode]();
+		if (lexerState->recordedLine)
+			recordCachedToken(token, lineNo);
+	}
 
 	// Captures end at their buffer's boundary no matter what
 	if (token.type == T_(YYEOF) && !lexerState->capturing) {
@@ -2222,11 +2396,12 @@ yy::parser::symbol_type yylex() {
 	}
 	lexerState->lastToken = token.type;
 	lexerState->atLineStart = token.type == T_(NEWLINE) || token.type == T_(EOB);
+	nbTokens++;
 
 	if (token.value.holds<uint32_t>()) {
 		return yy::parser::symbol_type(token.type, token.value.get<uint32_t>());
 	} else if (token.value.holds<std::string>()) {
-		return yy::parser::symbol_type(token.type, token.value.get<std::string>());
+		return yy::parser::symbol_type(token.type, std::move(token.value.get<std::string>()));
 	} else {
 		assume(token.value.empty());
 		return yy::parser::symbol_type(token.type);
@@ -2244,10 +2419,9 @@ static Capture startCapture() {
 	lexerState->captureSize = 0;
 
 	uint32_t lineNo = lexer_GetLineNo();
-	if (lexerState->content.holds<ViewedContent>() && lexerState->expansions.empty()) {
-		auto &view = lexerState->content.get<ViewedContent>();
+	if (lexerState->expansions.empty()) {
 		return {
-		    .lineNo = lineNo, .span = {.ptr = view.makeSharedContentPtr(), .size = 0}
+		    .lineNo = lineNo, .span = {.ptr = lexerState->content.makeSharedContentPtr(), .size = 0}
         };
 	} else {
 		assume(lexerState->captureBuf == nullptr);
@@ -2265,6 +2439,7 @@ static void endCapture(Capture &capture) {
 	if (!capture.span.ptr)
 		capture.span.ptr = lexerState->makeSharedCaptureBufPtr();
 	capture.span.size = lexerState->captureSize;
+	capture.span.tokenCache = std::make_shared<TokenCache>();
 
 	// ENDR/ENDM or EOF puts us past the start of the line
 	lexerState->atLineStart = false;
@@ -15,10 +15,12 @@
 #include "parser.hpp"
 #include "version.hpp"
 
+#include "asm/cache.hpp"
 #include "asm/charmap.hpp"
 #include "asm/fstack.hpp"
 #include "asm/opt.hpp"
 #include "asm/output.hpp"
+#include "asm/profile.hpp"
 #include "asm/symbol.hpp"
 #include "asm/warning.hpp"
 
@@ -48,7 +50,7 @@ static std::string make_escape(std::string &str) {
 }
 
 // Short options
-static char const *optstring = "b:D:Eg:I:M:o:P:p:Q:r:s:VvW:wX:";
+static char const *optstring = "b:c:D:Eg:I:M:o:P:p:Q:r:s:t:VvW:wX:";
 
 // Variables for the long-only options
 static int depType; // Variants of `-M`
@@ -63,6 +65,7 @@ static int depType; // Variants of `-M`
 // over short opt matching
 static option const longopts[] = {
     {"binary-digits",   required_argument, nullptr,  'b'},
+    {"cache-dir",       required_argument, nullptr,  'c'},
     {"define",          required_argument, nullptr,  'D'},
     {"export-all",      no_argument,       nullptr,  'E'},
     {"gfx-chars",       required_argument, nullptr,  'g'},
@@ -79,6 +82,7 @@ static option const longopts[] = {
     {"q-precision",     required_argument, nullptr,  'Q'},
     {"recursion-depth", required_argument, nullptr,  'r'},
     {"state",           required_argument, nullptr,  's'},
+    {"profile",         required_argument, nullptr,  't'},
     {"version",         no_argument,       nullptr,  'V'},
     {"verbose",         no_argument,       nullptr,  'v'},
     {"warning",         required_argument, nullptr,  'W'},
@@ -88,11 +92,11 @@ static option const longopts[] = {
 
 static void printUsage() {
 	fputs(
-	    "Usage: rgbasm [-EVvw] [-b chars] [-D name[=value]] [-g chars] [-I path]\n"
-	    "              [-M depend_file] [-MG] [-MP] [-MT target_file] [-MQ target_file]\n"
-	    "              [-o out_file] [-P include_file] [-p pad_value] [-Q precision]\n"
-	    "              [-r depth] [-s features:state_file] [-W warning] [-X max_errors]\n"
-	    "              <file>\n"
+	    "Usage: rgbasm [-EVvw] [-b chars] [-c cache_dir] [-D name[=value]] [-g chars]\n"
+	    "              [-I path] [-M depend_file] [-MG] [-MP] [-MT target_file]\n"
+	    "              [-MQ target_file] [-o out_file] [-P include_file] [-p pad_value]\n"
+	    "              [-Q precision] [-r depth] [-s features:state_file]\n"
+	    "              [-t profile_file] [-W warning] [-X max_errors] <file>\n"
 	    "Useful options:\n"
 	    "    -E, --export-all               export all labels\n"
 	    "    -M, --dependfile <path>        set the output dependency file\n"
@@ -136,6 +140,9 @@ int main(int argc, char *argv[]) {
 	if (isatty(STDERR_FILENO))
 		maxErrors = 100;
 
+	// Options like `-D` are parsed in-place, so hash them beforehand
+	cache_HashCommandLine(argc, argv);
+
 	for (int ch; (ch = musl_getopt_long_only(argc, argv, optstring, longopts, nullptr)) != -1;) {
 		switch (ch) {
 			char *endptr;
@@ -147,6 +154,10 @@ int main(int argc, char *argv[]) {
 				errx("Must specify exactly 2 characters for option 'b'");
 			break;
 
+		case 'c':
+			cache_SetDirectory(musl_optarg);
+			break;
+
 			char *equals;
 		case 'D':
 			equals = strchr(musl_optarg, '=');
@@ -284,6 +295,10 @@ int main(int argc, char *argv[]) {
 			break;
 		}
 
+		case 't':
+			prof_SetFileName(musl_optarg);
+			break;
+
 		case 'V':
 			printf("rgbasm %s\n", get_package_version_string());
 			exit(0);
@@ -371,6 +386,14 @@ int main(int argc, char *argv[]) {
 		fprintf(dependFile, "%s: %s\n", targetFileName.c_str(), mainFileName.c_str());
 	}
 
+	cache_Init(mainFileName);
+	if (!stateFileSpecs.empty())
+		cache_Disable("state files are not cached");
+	if (prof_IsEnabled())
+		cache_Disable("profiling requires assembling");
+	if (cache_Replay())
+		return 0;
+
 	charmap_New(DEFAULT_CHARMAP_NAME, nullptr);
 
 	// Init lexer and file stack, providing file info
@@ -380,6 +403,8 @@ int main(int argc, char *argv[]) {
 	if (yy::parser parser; parser.parse() != 0 && nbErrors == 0)
 		nbErrors = 1;
 
+	prof_WriteReport();
+
 	sect_CheckUnionClosed();
 	sect_CheckSizes();
 
@@ -391,6 +416,7 @@ int main(int argc, char *argv[]) {
 		return 0;
 
 	out_WriteObject();
+	cache_Store();
 
 	for (auto [name, features] : stateFileSpecs)
 		out_WriteState(name, features);
@@ -51,6 +51,7 @@
 	#include <string.h>
 	#include <string_view>
 
+	#include "asm/cache.hpp"
 	#include "asm/charmap.hpp"
 	#include "asm/fixpoint.hpp"
 	#include "asm/format.hpp"
@@ -1217,6 +1218,7 @@ print: POP_PRINT print_exprs trailing_comma;
 
 println:
 	POP_PRINTLN {
+		cache_Disable("PRINTLN output is not cached");
 		putchar('\n');
 		fflush(stdout);
 	}
@@ -1233,9 +1235,11 @@ print_exprs:
 
 print_expr:
 	const_no_str {
+		cache_Disable("PRINT output is not cached");
 		printf("$%" PRIX32, $1);
 	}
 	| string {
+		cache_Disable("PRINT output is not cached");
 		// Allow printing NUL characters
 		fwrite($1.data(), 1, $1.length(), stdout);
 	}
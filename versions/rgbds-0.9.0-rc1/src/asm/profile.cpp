@@ -0,0 +1,231 @@
+/* SPDX-License-Identifier: MIT */
+
+#include "asm/profile.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "error.hpp"
+#include "helpers.hpp" // assume, Defer, RANGE
+
+#include "asm/lexer.hpp"
+#include "asm/section.hpp"
+
+struct ProfileCounts {
+	int64_t time; // In nanoseconds
+	uint64_t nbTokens;
+	uint64_t nbBytes;
+};
+
+struct ProfileEntry {
+	ProfileKind kind;
+	std::string name;
+	uint64_t nbCalls;
+	int64_t totalTime; // Including the contexts that it entered, but only once for recursion
+	uint32_t nbActive; // How many times it is currently on the stack
+	ProfileCounts self; // Not counting the contexts that it entered
+};
+
+struct ProfileFrame {
+	size_t entryIdx;
+	ProfileCounts start;    // Counts when the context was entered
+	ProfileCounts children; // Inclusive counts of the contexts that it entered
+};
+
+struct TraceEvent {
+	size_t entryIdx;
+	int64_t start; // In nanoseconds since profiling began
+	int64_t duration;
+	uint64_t nbTokens;
+	uint64_t nbBytes;
+};
+
+static std::string fileName;
+static std::chrono::steady_clock::time_point startTime;
+
+static std::vector<ProfileEntry> entries;
+// Keyed by name, for each kind
+static std::unordered_map<std::string, size_t> entryIndexes[PROFILE_REPT + 1];
+static std::vector<ProfileFrame> frames;
+static std::vector<TraceEvent> traceEvents;
+
+static char const *kindNames[PROFILE_REPT + 1] = {"file", "macro", "rept"};
+
+static ProfileCounts currentCounts() {
+	auto elapsed = std::chrono::steady_clock::now() - startTime;
+
+	return {
+	    .time = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+	    .nbTokens = lexer_GetNbTokens(),
+	    .nbBytes = sect_GetNbBytesEmitted(),
+	};
+}
+
+void prof_SetFileName(std::string const &path) {
+	if (!fileName.empty())
+		warnx("Overriding profile filename %s", fileName.c_str());
+	fileName = path;
+	startTime = std::chrono::steady_clock::now();
+}
+
+bool prof_IsEnabled() {
+	return !fileName.empty();
+}
+
+void prof_EnterContext(ProfileKind kind, std::string const &name) {
+	if (!prof_IsEnabled())
+		return;
+
+	auto [search, inserted] = entryIndexes[kind].try_emplace(name, entries.size());
+	if (inserted)
+		entries.push_back({
+		    .kind = kind,
+		    .name = name,
+		    .nbCalls = 0,
+		    .totalTime = 0,
+		    .nbActive = 0,
+		    .self = {},
+		});
+	ProfileEntry &entry = entries[search->second];
+
+	entry.nbCalls++;
+	entry.nbActive++;
+	frames.push_back({.entryIdx = search->second, .start = currentCounts(), .children = {}});
+}
+
+void prof_ExitContext() {
+	if (!prof_IsEnabled())
+		return;
+
+	assume(!frames.empty());
+	ProfileFrame frame = frames.back();
+	frames.pop_back();
+
+	ProfileCounts now = currentCounts();
+	ProfileCounts total = {
+	    .time = now.time - frame.start.time,
+	    .nbTokens = now.nbTokens - frame.start.nbTokens,
+	    .nbBytes = now.nbBytes - frame.start.nbBytes,
+	};
+
+	ProfileEntry &entry = entries[frame.entryIdx];
+	entry.self.time += total.time - frame.children.time;
+	entry.self.nbTokens += total.nbTokens - frame.children.nbTokens;
+	entry.self.nbBytes += total.nbBytes - frame.children.nbBytes;
+	// A recursive macro's time is already counted by its outermost call
+	if (--entry.nbActive == 0)
+		entry.totalTime += total.time;
+
+	if (!frames.empty()) {
+		ProfileCounts &parent = frames.back().children;
+		parent.time += total.time;
+		parent.nbTokens += total.nbTokens;
+		parent.nbBytes += total.nbBytes;
+	}
+
+	traceEvents.push_back({
+	    .entryIdx = frame.entryIdx,
+	    .start = frame.start.time,
+	    .duration = total.time,
+	    .nbTokens = total.nbTokens,
+	    .nbBytes = total.nbBytes,
+	});
+}
+
+static void writeSummary(FILE *file) {
+	std::vector<ProfileEntry const *> sorted;
+	sorted.reserve(entries.size());
+	for (ProfileEntry const &entry : entries)
+		sorted.push_back(&entry);
+	std::stable_sort(RANGE(sorted), [](ProfileEntry const *lhs, ProfileEntry const *rhs) {
+		return lhs->self.time > rhs->self.time;
+	});
+
+	fprintf(
+	    file,
+	    "%12s %12s %10s %12s %10s  %s\n",
+	    "Self (ms)",
+	    "Total (ms)",
+	    "Calls",
+	    "Tokens",
+	    "Bytes",
+	    "Context"
+	);
+	for (ProfileEntry const *entry : sorted) {
+		fprintf(
+		    file,
+		    "%12.3f %12.3f %10" PRIu64 " %12" PRIu64 " %10" PRIu64 "  %s %s\n",
+		    entry->self.time / 1e6,
+		    entry->totalTime / 1e6,
+		    entry->nbCalls,
+		    entry->self.nbTokens,
+		    entry->self.nbBytes,
+		    kindNames[entry->kind],
+		    entry->name.c_str()
+		);
+	}
+}
+
+static void writeJSONString(FILE *file, std::string const &str) {
+	putc('"', file);
+	for (char c : str) {
+		if (c == '"' || c == '\\')
+			fprintf(file, "\\%c", c);
+		else if ((uint8_t)c < ' ')
+			fprintf(file, "\\u%04x", (uint8_t)c);
+		else
+			putc(c, file);
+	}
+	putc('"', file);
+}
+
+// Chrome's trace event format, which can be loaded in e.g. Perfetto or `about:tracing`
+static void writeTrace(FILE *file) {
+	fputs("{\"traceEvents\":[", file);
+	for (size_t i = 0; i < traceEvents.size(); i++) {
+		TraceEvent const &event = traceEvents[i];
+		ProfileEntry const &entry = entries[event.entryIdx];
+
+		fputs(i == 0 ? "\n" : ",\n", file);
+		fputs("{\"name\":", file);
+		writeJSONString(file, entry.name);
+		fprintf(
+		    file,
+		    ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1,"
+		    "\"args\":{\"tokens\":%" PRIu64 ",\"bytes\":%" PRIu64 "}}",
+		    kindNames[entry.kind],
+		    event.start / 1e3,
+		    event.duration / 1e3,
+		    event.nbTokens,
+		    event.nbBytes
+		);
+	}
+	fputs("\n]}\n", file);
+}
+
+void prof_WriteReport() {
+	if (!prof_IsEnabled())
+		return;
+
+	while (!frames.empty())
+		prof_ExitContext();
+
+	FILE *file = fopen(fileName.c_str(), "w");
+	if (!file)
+		err("Failed to open profile file \"%s\"", fileName.c_str());
+	Defer closeFile{[&] { fclose(file); }};
+	writeSummary(file);
+
+	std::string traceName = fileName + ".json";
+	FILE *traceFile = fopen(traceName.c_str(), "w");
+	if (!traceFile)
+		err("Failed to open profile trace file \"%s\"", traceName.c_str());
+	Defer closeTraceFile{[&] { fclose(traceFile); }};
+	writeTrace(traceFile);
+}
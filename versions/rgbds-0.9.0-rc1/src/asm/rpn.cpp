@@ -89,7 +89,7 @@ void Expression::makeSymbol(std::string const &symName) {
 		*ptr++ = RPN_SYM;
 		memcpy(ptr, sym->name.c_str(), nameLen);
 	} else {
-		data = (int32_t)sym_GetConstantValue(symName);
+		data = (int32_t)sym->getConstantValue();
 	}
 }
 
@@ -2,6 +2,8 @@
 
 #include "asm/section.hpp"
 
+#include <sys/stat.h>
+
 #include <algorithm>
 #include <errno.h>
 #include <inttypes.h>
@@ -10,9 +12,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "helpers.hpp"
+#include "platform.hpp"
 
 #include "asm/fstack.hpp"
 #include "asm/lexer.hpp"
@@ -22,6 +27,11 @@
 #include "asm/symbol.hpp"
 #include "asm/warning.hpp"
 
+// Neither MSVC nor MinGW provide `mmap`
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+	#include <sys/mman.h>
+#endif
+
 uint8_t fillByte;
 
 struct UnionStackEntry {
@@ -47,6 +57,7 @@ Section *currentSection = nullptr;
 static Section *currentLoadSection = nullptr;
 static std::pair<Symbol const *, Symbol const *> currentLoadLabelScopes = {nullptr, nullptr};
 int32_t loadOffset; // Offset into the LOAD section's parent (see sect_GetOutputOffset)
+static uint64_t nbBytesEmitted = 0;
 
 // A quick check to see if we have an initialized section
 [[nodiscard]] static bool requireSection() {
@@ -507,6 +518,10 @@ uint32_t sect_GetOutputOffset() {
 	return curOffset + loadOffset;
 }
 
+uint64_t sect_GetNbBytesEmitted() {
+	return nbBytesEmitted;
+}
+
 // Returns how many bytes need outputting for the specified alignment and offset to succeed
 uint32_t sect_GetAlignBytes(uint8_t alignment, uint16_t offset) {
 	Section *sect = sect_GetSymbolSection();
@@ -562,10 +577,11 @@ void sect_AlignPC(uint8_t alignment, uint16_t offset) {
 	}
 }
 
-static void growSection(uint32_t growth) {
-	if (growth > 0 && curOffset > UINT32_MAX - growth)
+static void growSection(size_t growth) {
+	if (growth > UINT32_MAX - curOffset)
 		fatalerror("Section size would overflow internal counter\n");
 	curOffset += growth;
+	nbBytesEmitted += growth;
 	if (uint32_t outOffset = sect_GetOutputOffset(); outOffset > currentSection->size)
 		currentSection->size = outOffset;
 	if (currentLoadSection && curOffset > currentLoadSection->size)
@@ -578,6 +594,16 @@ static void writeByte(uint8_t byte) {
 	growSection(1);
 }
 
+static void writeBytes(uint8_t const *bytes, size_t count) {
+	if (uint32_t index = sect_GetOutputOffset(); index < currentSection->data.size())
+		memcpy(
+		    &currentSection->data[index],
+		    bytes,
+		    std::min(count, currentSection->data.size() - index)
+		);
+	growSection(count);
+}
+
 static void writeWord(uint16_t value) {
 	writeByte(value & 0xFF);
 	writeByte(value >> 8);
@@ -799,17 +825,59 @@ void sect_PCRelByte(Expression &expr, uint32_t pcShift) {
 	}
 }
 
-// Output a binary file
-void sect_BinaryFile(std::string const &name, int32_t startPos) {
-	if (startPos < 0) {
-		error("Start position cannot be negative (%" PRId32 ")\n", startPos);
-		startPos = 0;
+// The contents of an INCBIN file, mapped in memory if possible, and otherwise read into a buffer
+class BinaryFile {
+	void *mapping = nullptr; // As returned by `mmap`, to be given back to `munmap`
+	size_t mappingSize;
+	std::vector<uint8_t> buffer;
+
+public:
+	BinaryFile() = default;
+	BinaryFile(BinaryFile const &) = delete;
+	~BinaryFile() {
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+		if (mapping)
+			munmap(mapping, mappingSize);
+#endif
+	}
+
+	// Returns whether the contents could be loaded; if not, `errno` has been set
+	bool load(FILE *file) {
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+		if (struct stat statBuf; fstat(fileno(file), &statBuf) == 0 && S_ISREG(statBuf.st_mode)
+		                         && statBuf.st_size > 0) {
+			void *mappingAddr =
+			    mmap(nullptr, statBuf.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+			if (mappingAddr != MAP_FAILED) {
+				mapping = mappingAddr;
+				mappingSize = statBuf.st_size;
+				return true;
+			}
+		}
+#endif
+		// Sometimes mmap() fails or isn't available (e.g. for pipes), so have a fallback
+		uint8_t buf[BUFSIZ];
+		for (size_t nbRead; (nbRead = fread(buf, 1, sizeof(buf), file)) != 0;)
+			buffer.insert(buffer.end(), buf, buf + nbRead);
+		return !ferror(file);
+	}
+
+	uint8_t const *data() const { return mapping ? (uint8_t const *)mapping : buffer.data(); }
+	size_t size() const { return mapping ? mappingSize : buffer.size(); }
+};
+
+// INCBIN files are only read once, however many times (and slices) they are included
+static std::unordered_map<std::string, BinaryFile> binaryFiles; // Keyed by resolved path
+
+static BinaryFile const *getBinaryFile(std::string const &name) {
+	std::optional<std::string> fullPath = fstk_FindFile(name);
+	if (fullPath) {
+		if (auto search = binaryFiles.find(*fullPath); search != binaryFiles.end())
+			return &search->second;
 	}
-	if (!requireCodeSection())
-		return;
 
 	FILE *file = nullptr;
-	if (std::optional<std::string> fullPath = fstk_FindFile(name); fullPath)
+	if (fullPath)
 		file = fopen(fullPath->c_str(), "rb");
 	if (!file) {
 		if (generatedMissingIncludes) {
@@ -819,38 +887,38 @@ void sect_BinaryFile(std::string const &name, int32_t startPos) {
 		} else {
 			error("Error opening INCBIN file '%s': %s\n", name.c_str(), strerror(errno));
 		}
-		return;
+		return nullptr;
 	}
 	Defer closeFile{[&] { fclose(file); }};
 
-	if (fseek(file, 0, SEEK_END) != -1) {
-		if (startPos > ftell(file)) {
-			error("Specified start position is greater than length of file '%s'\n", name.c_str());
-			return;
-		}
-		// The file is seekable; skip to the specified start position
-		fseek(file, startPos, SEEK_SET);
-	} else {
-		if (errno != ESPIPE)
-			error(
-			    "Error determining size of INCBIN file '%s': %s\n", name.c_str(), strerror(errno)
-			);
-		// The file isn't seekable, so we'll just skip bytes one at a time
-		while (startPos--) {
-			if (fgetc(file) == EOF) {
-				error(
-				    "Specified start position is greater than length of file '%s'\n", name.c_str()
-				);
-				return;
-			}
-		}
+	auto [search, inserted] = binaryFiles.try_emplace(*fullPath);
+	assume(inserted);
+	if (!search->second.load(file)) {
+		error("Error reading INCBIN file '%s': %s\n", name.c_str(), strerror(errno));
+		binaryFiles.erase(search);
+		return nullptr;
+	}
+	return &search->second;
+}
+
+// Output a binary file
+void sect_BinaryFile(std::string const &name, int32_t startPos) {
+	if (startPos < 0) {
+		error("Start position cannot be negative (%" PRId32 ")\n", startPos);
+		startPos = 0;
 	}
+	if (!requireCodeSection())
+		return;
 
-	for (int byte; (byte = fgetc(file)) != EOF;)
-		writeByte(byte);
+	BinaryFile const *file = getBinaryFile(name);
+	if (!file)
+		return;
 
-	if (ferror(file))
-		error("Error reading INCBIN file '%s': %s\n", name.c_str(), strerror(errno));
+	if ((size_t)startPos > file->size()) {
+		error("Specified start position is greater than length of file '%s'\n", name.c_str());
+		return;
+	}
+	writeBytes(&file->data()[startPos], file->size() - startPos);
 }
 
 // Output a slice of a binary file
@@ -868,67 +936,25 @@ void sect_BinaryFileSlice(std::string const &name, int32_t startPos, int32_t len
 	if (length == 0) // Don't even bother with 0-byte slices
 		return;
 
-	FILE *file = nullptr;
-	if (std::optional<std::string> fullPath = fstk_FindFile(name); fullPath)
-		file = fopen(fullPath->c_str(), "rb");
-	if (!file) {
-		if (generatedMissingIncludes) {
-			if (verbose)
-				printf("Aborting (-MG) on INCBIN file '%s' (%s)\n", name.c_str(), strerror(errno));
-			failedOnMissingInclude = true;
-		} else {
-			error("Error opening INCBIN file '%s': %s\n", name.c_str(), strerror(errno));
-		}
+	BinaryFile const *file = getBinaryFile(name);
+	if (!file)
 		return;
-	}
-	Defer closeFile{[&] { fclose(file); }};
 
-	if (fseek(file, 0, SEEK_END) != -1) {
-		if (int32_t fsize = ftell(file); startPos > fsize) {
-			error("Specified start position is greater than length of file '%s'\n", name.c_str());
-			return;
-		} else if (startPos + length > fsize) {
-			error(
-			    "Specified range in INCBIN file '%s' is out of bounds (%" PRIu32 " + %" PRIu32
-			    " > %" PRIu32 ")\n",
-			    name.c_str(),
-			    startPos,
-			    length,
-			    fsize
-			);
-			return;
-		}
-		// The file is seekable; skip to the specified start position
-		fseek(file, startPos, SEEK_SET);
-	} else {
-		if (errno != ESPIPE)
-			error(
-			    "Error determining size of INCBIN file '%s': %s\n", name.c_str(), strerror(errno)
-			);
-		// The file isn't seekable, so we'll just skip bytes one at a time
-		while (startPos--) {
-			if (fgetc(file) == EOF) {
-				error(
-				    "Specified start position is greater than length of file '%s'\n", name.c_str()
-				);
-				return;
-			}
-		}
-	}
-
-	while (length--) {
-		if (int byte = fgetc(file); byte != EOF) {
-			writeByte(byte);
-		} else if (ferror(file)) {
-			error("Error reading INCBIN file '%s': %s\n", name.c_str(), strerror(errno));
-		} else {
-			error(
-			    "Premature end of INCBIN file '%s' (%" PRId32 " bytes left to read)\n",
-			    name.c_str(),
-			    length + 1
-			);
-		}
+	if (size_t fsize = file->size(); (size_t)startPos > fsize) {
+		error("Specified start position is greater than length of file '%s'\n", name.c_str());
+		return;
+	} else if ((size_t)startPos + length > fsize) {
+		error(
+		    "Specified range in INCBIN file '%s' is out of bounds (%" PRIu32 " + %" PRIu32
+		    " > %zu)\n",
+		    name.c_str(),
+		    startPos,
+		    length,
+		    fsize
+		);
+		return;
 	}
+	writeBytes(&file->data()[startPos], length);
 }
 
 // Section stack routines
@@ -4,6 +4,7 @@
 
 #include <inttypes.h>
 #include <stdio.h>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -11,6 +12,7 @@
 #include "helpers.hpp" // assume
 #include "version.hpp"
 
+#include "asm/cache.hpp"
 #include "asm/fstack.hpp"
 #include "asm/lexer.hpp"
 #include "asm/macro.hpp"
@@ -19,8 +21,45 @@
 
 using namespace std::literals;
 
-std::unordered_map<std::string, Symbol> symbols;
-std::unordered_set<std::string> purgedSymbols;
+// An auto-scoped local label's name, split into its global scope and its unqualified name,
+// so that it can be looked up without first concatenating both
+struct ScopedName {
+	std::string_view scope;
+	std::string_view name;
+};
+
+struct SymbolNameHash {
+	using is_transparent = void;
+
+	// FNV-1a hash, which can go through a `ScopedName`'s parts as if they were concatenated
+	static size_t hash(size_t hash, std::string_view str) {
+		for (char c : str)
+			hash = (hash ^ (uint8_t)c) * 16777619;
+		return hash;
+	}
+
+	// Not `noexcept`, so that the standard library caches the hashes alongside the names
+	size_t operator()(std::string_view str) const { return hash(0x811C9DC5, str); }
+	size_t operator()(ScopedName const &name) const {
+		return hash(hash(0x811C9DC5, name.scope), name.name);
+	}
+};
+
+struct SymbolNameEqual {
+	using is_transparent = void;
+
+	bool operator()(std::string_view str1, std::string_view str2) const { return str1 == str2; }
+	bool operator()(ScopedName const &name, std::string_view str) const {
+		return str.length() == name.scope.length() + name.name.length()
+		       && str.starts_with(name.scope) && str.ends_with(name.name);
+	}
+	bool operator()(std::string_view str, ScopedName const &name) const {
+		return (*this)(name, str);
+	}
+};
+
+std::unordered_map<std::string, Symbol, SymbolNameHash, SymbolNameEqual> symbols;
+std::unordered_set<std::string, SymbolNameHash, SymbolNameEqual> purgedSymbols;
 
 static Symbol const *globalScope = nullptr; // Current section's global label scope
 static Symbol const *localScope = nullptr; // Current section's local label scope
@@ -33,6 +72,9 @@ static char savedTIME[256];
 static char savedDATE[256];
 static char savedTIMESTAMP_ISO8601_LOCAL[256];
 static char savedTIMESTAMP_ISO8601_UTC[256];
+// Range of `defIndex`es of the built-in symbols derived from the current time
+static uint32_t firstTimeDefIndex = UINT32_MAX;
+static uint32_t lastTimeDefIndex = 0;
 static bool exportAll;
 
 bool sym_IsPC(Symbol const *sym) {
@@ -150,7 +192,7 @@ static void redefinedError(Symbol const &sym) {
 	}
 }
 
-static void assumeAlreadyExpanded(std::string const &symName) {
+static void assumeAlreadyExpanded(std::string_view symName) {
 	// Either the symbol name is `Global.local` or entirely '.'s (for scopes `.` and `..`),
 	// but cannot be unqualified `.local`
 	assume(!symName.starts_with('.') || symName.find_first_not_of('.') == symName.npos);
@@ -175,7 +217,7 @@ static Symbol &createSymbol(std::string const &symName) {
 	return sym;
 }
 
-static bool isAutoScoped(std::string const &symName) {
+static bool isAutoScoped(std::string_view symName) {
 	// `globalScope` should be global if it's defined
 	assume(!globalScope || globalScope->name.find('.') == std::string::npos);
 	// `localScope` should be qualified local if it's defined
@@ -184,7 +226,7 @@ static bool isAutoScoped(std::string const &symName) {
 	size_t dotPos = symName.find('.');
 
 	// If there are no dots, it's not a local label
-	if (dotPos == std::string::npos)
+	if (dotPos == symName.npos)
 		return false;
 
 	// Label scopes `.` and `..` are the only nonlocal identifiers that start with a dot
@@ -193,11 +235,19 @@ static bool isAutoScoped(std::string const &symName) {
 
 	// Check for nothing after the dot
 	if (dotPos == symName.length() - 1)
-		fatalerror("'%s' is a nonsensical reference to an empty local label\n", symName.c_str());
+		fatalerror(
+		    "'%.*s' is a nonsensical reference to an empty local label\n",
+		    (int)symName.length(),
+		    symName.data()
+		);
 
 	// Check for more than one dot
-	if (symName.find('.', dotPos + 1) != std::string::npos)
-		fatalerror("'%s' is a nonsensical reference to a nested local label\n", symName.c_str());
+	if (symName.find('.', dotPos + 1) != symName.npos)
+		fatalerror(
+		    "'%.*s' is a nonsensical reference to a nested local label\n",
+		    (int)symName.length(),
+		    symName.data()
+		);
 
 	// Check for already-qualified local label
 	if (dotPos > 0)
@@ -205,23 +255,38 @@ static bool isAutoScoped(std::string const &symName) {
 
 	// Check for unqualifiable local label
 	if (!globalScope)
-		fatalerror("Unqualified local label '%s' in main scope\n", symName.c_str());
+		fatalerror(
+		    "Unqualified local label '%.*s' in main scope\n", (int)symName.length(), symName.data()
+		);
 
 	return true;
 }
 
-Symbol *sym_FindExactSymbol(std::string const &symName) {
+template<typename NameT>
+static Symbol *findSymbol(NameT const &symName) {
+	auto search = symbols.find(symName);
+	if (search == symbols.end())
+		return nullptr;
+
+	Symbol &sym = search->second;
+	if (sym.isBuiltin && sym.defIndex >= firstTimeDefIndex && sym.defIndex <= lastTimeDefIndex)
+		cache_UseCurrentTime();
+	return &sym;
+}
+
+Symbol *sym_FindExactSymbol(std::string_view symName) {
 	assumeAlreadyExpanded(symName);
 
-	auto search = symbols.find(symName);
-	return search != symbols.end() ? &search->second : nullptr;
+	return findSymbol(symName);
 }
 
-Symbol *sym_FindScopedSymbol(std::string const &symName) {
-	return sym_FindExactSymbol(isAutoScoped(symName) ? globalScope->name + symName : symName);
+Symbol *sym_FindScopedSymbol(std::string_view symName) {
+	if (isAutoScoped(symName))
+		return findSymbol(ScopedName{.scope = globalScope->name, .name = symName});
+	return sym_FindExactSymbol(symName);
 }
 
-Symbol *sym_FindScopedValidSymbol(std::string const &symName) {
+Symbol *sym_FindScopedValidSymbol(std::string_view symName) {
 	Symbol *sym = sym_FindScopedSymbol(symName);
 
 	// `@` has no value outside of a section
@@ -275,14 +340,18 @@ void sym_Purge(std::string const &symName) {
 	}
 }
 
-bool sym_IsPurgedExact(std::string const &symName) {
+bool sym_IsPurgedExact(std::string_view symName) {
 	assumeAlreadyExpanded(symName);
 
 	return purgedSymbols.find(symName) != purgedSymbols.end();
 }
 
-bool sym_IsPurgedScoped(std::string const &symName) {
-	return sym_IsPurgedExact(isAutoScoped(symName) ? globalScope->name + symName : symName);
+bool sym_IsPurgedScoped(std::string_view symName) {
+	if (isAutoScoped(symName)) {
+		ScopedName name{.scope = globalScope->name, .name = symName};
+		return purgedSymbols.find(name) != purgedSymbols.end();
+	}
+	return sym_IsPurgedExact(symName);
 }
 
 int32_t sym_GetRSValue() {
@@ -653,7 +722,9 @@ void sym_Init(time_t now) {
 	    time_utc
 	);
 
-	sym_AddString("__TIME__"s, std::make_shared<std::string>(savedTIME))->isBuiltin = true;
+	Symbol *timeSymbol = sym_AddString("__TIME__"s, std::make_shared<std::string>(savedTIME));
+	timeSymbol->isBuiltin = true;
+	firstTimeDefIndex = timeSymbol->defIndex;
 	sym_AddString("__DATE__"s, std::make_shared<std::string>(savedDATE))->isBuiltin = true;
 	sym_AddString(
 	    "__ISO_8601_LOCAL__"s, std::make_shared<std::string>(savedTIMESTAMP_ISO8601_LOCAL)
@@ -667,5 +738,7 @@ void sym_Init(time_t now) {
 	sym_AddEqu("__UTC_DAY__"s, time_utc->tm_mday)->isBuiltin = true;
 	sym_AddEqu("__UTC_HOUR__"s, time_utc->tm_hour)->isBuiltin = true;
 	sym_AddEqu("__UTC_MINUTE__"s, time_utc->tm_min)->isBuiltin = true;
-	sym_AddEqu("__UTC_SECOND__"s, time_utc->tm_sec)->isBuiltin = true;
+	Symbol *secondSymbol = sym_AddEqu("__UTC_SECOND__"s, time_utc->tm_sec);
+	secondSymbol->isBuiltin = true;
+	lastTimeDefIndex = secondSymbol->defIndex;
 }
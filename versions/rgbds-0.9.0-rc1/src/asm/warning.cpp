@@ -13,6 +13,7 @@
 #include "helpers.hpp" // QUOTEDSTRLEN
 #include "itertools.hpp"
 
+#include "asm/cache.hpp"
 #include "asm/fstack.hpp"
 #include "asm/lexer.hpp"
 #include "asm/main.hpp"
@@ -338,6 +339,9 @@ void processWarningFlag(char const *flag) {
 void printDiag(
     char const *fmt, va_list args, char const *type, char const *flagfmt, char const *flag
 ) {
+	// Diagnostics are not replayed from the cache, so ensure they are always shown
+	cache_Disable("diagnostics were printed");
+
 	fputs(type, stderr);
 	fputs(": ", stderr);
 	fstk_DumpCurrent();
@@ -350,6 +354,8 @@ void printDiag(
 void error(char const *fmt, ...) {
 	va_list args;
 
+	lexer_MarkTokenVarying(); // The diagnostic must be printed again if the token is re-lexed
+
 	va_start(args, fmt);
 	printDiag(fmt, args, "error", ":", nullptr);
 	va_end(args);
@@ -379,6 +385,9 @@ void warning(WarningID id, char const *fmt, ...) {
 	char const *flag = warningFlags[id];
 	va_list args;
 
+	// Even disabled warnings may become enabled when the token is re-lexed
+	lexer_MarkTokenVarying();
+
 	va_start(args, fmt);
 
 	switch (warningState(id)) {
@@ -10,13 +10,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "extern/getopt.hpp"
 #include "helpers.hpp"
+#include "parallel.hpp"
 #include "platform.hpp"
 #include "version.hpp"
 
+// Neither MSVC nor MinGW provide `mmap`
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+	#include <sys/mman.h>
+#endif
+
 #define UNSPECIFIED 0x200 // Should not be in byte range
 
 #define BANK_SIZE 0x4000
@@ -76,15 +85,49 @@ static void printUsage() {
 
 static uint8_t nbErrors;
 
+// Files are fixed in parallel, but their diagnostics are printed afterwards in command-line order,
+// so that the output is the same as if they had been fixed one after the other. Thus, while fixing
+// a file, its diagnostics are logged, to be printed once all threads are done.
+struct FileLog {
+	std::string messages;
+	uint8_t nbErrors = 0;
+};
+
+static thread_local FileLog *curLog = nullptr; // The log of the file this thread is fixing, if any
+
+[[gnu::format(printf, 1, 0)]] static void vlogMessage(char const *fmt, va_list ap) {
+	if (!curLog) {
+		vfprintf(stderr, fmt, ap);
+		return;
+	}
+
+	va_list apCopy;
+	va_copy(apCopy, ap);
+	size_t start = curLog->messages.length();
+	int len = vsnprintf(nullptr, 0, fmt, ap);
+	curLog->messages.resize(start + len + 1); // Make room for the terminator as well
+	vsnprintf(&curLog->messages[start], len + 1, fmt, apCopy);
+	curLog->messages.resize(start + len);
+	va_end(apCopy);
+}
+
+[[gnu::format(printf, 1, 2)]] static void logMessage(char const *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	vlogMessage(fmt, ap);
+	va_end(ap);
+}
+
 [[gnu::format(printf, 1, 2)]] static void report(char const *fmt, ...) {
 	va_list ap;
 
 	va_start(ap, fmt);
-	vfprintf(stderr, fmt, ap);
+	vlogMessage(fmt, ap);
 	va_end(ap);
 
-	if (nbErrors != UINT8_MAX)
-		nbErrors++;
+	if (uint8_t &count = curLog ? curLog->nbErrors : nbErrors; count != UINT8_MAX)
+		count++;
 }
 
 enum MbcType {
@@ -828,7 +871,7 @@ static void overwriteByte(uint8_t *rom0, uint16_t addr, uint8_t fixedByte, char
 	uint8_t origByte = rom0[addr];
 
 	if (!overwriteRom && origByte != 0 && origByte != fixedByte)
-		fprintf(stderr, "warning: Overwrote a non-zero byte in the %s\n", areaName);
+		logMessage("warning: Overwrote a non-zero byte in the %s\n", areaName);
 
 	rom0[addr] = fixedByte;
 }
@@ -848,7 +891,7 @@ static void overwriteBytes(
 			uint8_t origByte = rom0[i + startAddr];
 
 			if (origByte != 0 && origByte != fixed[i]) {
-				fprintf(stderr, "warning: Overwrote a non-zero byte in the %s\n", areaName);
+				logMessage("warning: Overwrote a non-zero byte in the %s\n", areaName);
 				break;
 			}
 		}
@@ -857,6 +900,59 @@ static void overwriteBytes(
 	memcpy(&rom0[startAddr], fixed, size);
 }
 
+// Sums bytes modulo 2^16, like the global checksum does; eight bytes are summed at a time, in
+// four 16-bit lanes, which are added together before any of them can overflow into the next
+static uint16_t sumBytes(uint8_t const *data, size_t len) {
+	uint16_t sum = 0;
+	size_t i = 0;
+
+	while (i + 8 <= len) {
+		uint64_t lanes = 0;
+		// Each word adds at most 2 * 255 to each lane, so 128 words cannot overflow them
+		for (size_t end = i + 8 * 128 < len ? i + 8 * 128 : len; i + 8 <= end; i += 8) {
+			uint64_t word;
+			memcpy(&word, &data[i], sizeof(word));
+			lanes += word & 0x00FF'00FF'00FF'00FF;
+			lanes += (word >> 8) & 0x00FF'00FF'00FF'00FF;
+		}
+		sum += lanes + (lanes >> 16) + (lanes >> 32) + (lanes >> 48);
+	}
+	for (; i < len; i++)
+		sum += data[i];
+	return sum;
+}
+
+/*
+ * Sums the bytes of a regular file, starting from its current position
+ * @param input File descriptor to be read
+ * @param fileSize The file's size
+ * @return The bytes' sum, modulo 2^16
+ */
+static uint16_t sumRemainingBytes(int input, off_t fileSize) {
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+	// Mappings must begin on a page boundary, so the whole file is mapped
+	if (off_t pos = lseek(input, 0, SEEK_CUR); pos != (off_t)-1 && pos < fileSize) {
+		void *mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, input, 0);
+		if (mapping != MAP_FAILED) {
+			uint16_t sum = sumBytes(&((uint8_t const *)mapping)[pos], fileSize - pos);
+			munmap(mapping, fileSize);
+			return sum;
+		}
+	}
+#endif
+	// Sometimes mmap() fails or isn't available, so have a fallback
+	uint16_t sum = 0;
+	uint8_t bank[BANK_SIZE];
+	for (;;) {
+		ssize_t bankLen = readBytes(input, bank, sizeof(bank));
+
+		if (bankLen > 0)
+			sum += sumBytes(bank, bankLen);
+		if (bankLen != sizeof(bank))
+			return sum;
+	}
+}
+
 /*
  * @param input File descriptor to be used for reading
  * @param output File descriptor to be used for writing, may be equal to `input`
@@ -948,10 +1044,8 @@ static void processFile(int input, int output, char const *name, off_t fileSize)
 	if (oldLicensee != UNSPECIFIED)
 		overwriteByte(rom0, 0x14B, oldLicensee, "old licensee code");
 	else if (sgb && rom0[0x14B] != 0x33)
-		fprintf(
-		    stderr,
-		    "warning: SGB compatibility enabled, but old licensee was 0x%02x, not 0x33\n",
-		    rom0[0x14B]
+		logMessage(
+		    "warning: SGB compatibility enabled, but old licensee was 0x%02x, not 0x33\n", rom0[0x14B]
 		);
 
 	if (romVersion != UNSPECIFIED)
@@ -1003,8 +1097,7 @@ static void processFile(int input, int output, char const *name, off_t fileSize)
 				nbBanks++;
 
 				// Update global checksum, too
-				for (uint16_t i = 0; i < bankLen; i++)
-					globalSum += romx[totalRomxLen + i];
+				globalSum += sumBytes(&romx[totalRomxLen], bankLen);
 				totalRomxLen += bankLen;
 			}
 			// Stop when an incomplete bank has been read
@@ -1057,21 +1150,11 @@ static void processFile(int input, int output, char const *name, off_t fileSize)
 	if (fixSpec & (FIX_GLOBAL_SUM | TRASH_GLOBAL_SUM)) {
 		// Computation of the global checksum does not include the checksum bytes
 		assume(rom0Len >= 0x14E);
-		for (uint16_t i = 0; i < 0x14E; i++)
-			globalSum += rom0[i];
-		for (uint16_t i = 0x150; i < rom0Len; i++)
-			globalSum += rom0[i];
+		globalSum += sumBytes(rom0, 0x14E);
+		globalSum += sumBytes(&rom0[0x150], rom0Len - 0x150);
 		// Pipes have already read ROMX and updated globalSum, but not regular files
-		if (input == output) {
-			for (;;) {
-				ssize_t bankLen = readBytes(input, bank, sizeof(bank));
-
-				for (uint16_t i = 0; i < bankLen; i++)
-					globalSum += bank[i];
-				if (bankLen != sizeof(bank))
-					break;
-			}
-		}
+		if (input == output)
+			globalSum += sumRemainingBytes(input, fileSize);
 
 		if (fixSpec & TRASH_GLOBAL_SUM)
 			globalSum = ~globalSum;
@@ -1156,8 +1239,8 @@ static void processFile(int input, int output, char const *name, off_t fileSize)
 	}
 }
 
-static bool processFilename(char const *name) {
-	nbErrors = 0;
+static void processFilename(char const *name, FileLog &log) {
+	curLog = &log;
 
 	if (!strcmp(name, "-")) {
 		(void)setmode(STDIN_FILENO, O_BINARY);
@@ -1196,15 +1279,14 @@ static bool processFilename(char const *name) {
 		}
 	}
 
-	if (nbErrors)
-		fprintf(
-		    stderr,
+	if (log.nbErrors)
+		logMessage(
 		    "Fixing \"%s\" failed with %u error%s\n",
 		    name,
-		    nbErrors,
-		    nbErrors == 1 ? "" : "s"
+		    log.nbErrors,
+		    log.nbErrors == 1 ? "" : "s"
 		);
-	return nbErrors;
+	curLog = nullptr;
 }
 
 static void parseByte(uint16_t &output, char name) {
@@ -1486,9 +1568,34 @@ int main(int argc, char *argv[]) {
 		exit(1);
 	}
 
-	do {
-		failed |= processFilename(*argv);
-	} while (*++argv);
+	size_t nbFiles = 0;
+	// A file given more than once, even under different paths or through links, must be fixed
+	// one time after the other; so must standard input, which `-` always refers to. (Where inode
+	// numbers are not available, all files compare equal, so they are all fixed in order.)
+	unsigned nbThreads = defaultNbThreads();
+	std::set<std::pair<dev_t, ino_t>> fileIDs;
+	for (bool hasStdin = false; argv[nbFiles]; nbFiles++) {
+		struct stat statBuf;
+		if (!strcmp(argv[nbFiles], "-")) {
+			if (hasStdin)
+				nbThreads = 1;
+			hasStdin = true;
+			if (fstat(STDIN_FILENO, &statBuf) != 0)
+				continue;
+		} else if (stat(argv[nbFiles], &statBuf) != 0) {
+			continue; // Opening the file will fail, and report why
+		}
+		if (!fileIDs.insert({statBuf.st_dev, statBuf.st_ino}).second)
+			nbThreads = 1;
+	}
+
+	std::vector<FileLog> logs(nbFiles);
+	parallelFor(nbFiles, nbThreads, [&](size_t i) { processFilename(argv[i], logs[i]); });
+	for (FileLog const &log : logs) {
+		fputs(log.messages.c_str(), stderr);
+		if (log.nbErrors)
+			failed = true;
+	}
 
 	return failed;
 }
@@ -3,21 +3,27 @@
 #include "gfx/main.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <ctype.h>
 #include <inttypes.h>
 #include <ios>
 #include <limits>
+#include <mutex>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string>
 #include <string_view>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
 #include "extern/getopt.hpp"
 #include "file.hpp"
 #include "helpers.hpp" // assume
+#include "parallel.hpp"
 #include "platform.hpp"
 #include "version.hpp"
 
@@ -27,22 +33,61 @@
 
 using namespace std::literals::string_view_literals;
 
-Options options;
+thread_local Options options;
 
-static struct LocalOptions {
-	char const *externalPalSpec;
+struct LocalOptions {
+	std::string externalPalSpec;
 	bool autoAttrmap;
 	bool autoTilemap;
 	bool autoPalettes;
 	bool autoPalmap;
 	bool groupOutputs;
 	bool reverse;
-} localOptions;
+};
+static thread_local LocalOptions localOptions;
+
+static char const *batchFileName = nullptr; // -B
+static bool isParsingBatchJob = false;
 
-static uintmax_t nbErrors;
+static thread_local uintmax_t nbErrors;
+
+// The state shared by the threads running a batch's jobs (see `runBatch`)
+struct BatchState {
+	std::atomic_bool failed = false; // Once a job has given up, no more jobs are started
+	std::mutex mutex;
+	std::condition_variable workerStopped;
+	size_t nbWorkersRunning; // Protected by `mutex`
+};
+// This lives on `runBatch`'s stack, so that it is not destroyed by `exit` while still in use
+static BatchState *batch = nullptr;
+static thread_local bool isBatchWorker = false;
+
+// A batch job that gives up must not exit while the others are still writing their outputs, so
+// it waits for them to be done first.
+[[noreturn]] static void failBatchJob() {
+	batch->failed = true;
+	std::unique_lock lock(batch->mutex);
+	--batch->nbWorkersRunning;
+	batch->workerStopped.notify_all();
+	batch->workerStopped.wait(lock, [] { return batch->nbWorkersRunning == 0; });
+	exit(1); // With the lock held, so that no other failed job exits concurrently
+}
 
 [[noreturn]] void giveUp() {
-	fprintf(stderr, "Conversion aborted after %ju error%s\n", nbErrors, nbErrors == 1 ? "" : "s");
+	if (batchFileName && !options.input.empty())
+		fprintf(
+		    stderr,
+		    "Conversion of \"%s\" aborted after %ju error%s\n",
+		    options.input.c_str(),
+		    nbErrors,
+		    nbErrors == 1 ? "" : "s"
+		);
+	else
+		fprintf(
+		    stderr, "Conversion aborted after %ju error%s\n", nbErrors, nbErrors == 1 ? "" : "s"
+		);
+	if (isBatchWorker)
+		failBatchJob();
 	exit(1);
 }
 
@@ -52,24 +97,36 @@ void requireZeroErrors() {
 	}
 }
 
+// Prints a whole diagnostic at once, so that those of images being converted in parallel do not
+// get mixed together
+[[gnu::format(printf, 2, 0)]] static void printDiag(char const *type, char const *fmt, va_list ap) {
+	va_list apCopy;
+	va_copy(apCopy, ap);
+	std::string message = type;
+	size_t start = message.length();
+	int len = vsnprintf(nullptr, 0, fmt, ap);
+	message.resize(start + len + 1); // Make room for the terminator as well
+	vsnprintf(&message[start], len + 1, fmt, apCopy);
+	message.back() = '\n';
+	va_end(apCopy);
+
+	fputs(message.c_str(), stderr);
+}
+
 void warning(char const *fmt, ...) {
 	va_list ap;
 
-	fputs("warning: ", stderr);
 	va_start(ap, fmt);
-	vfprintf(stderr, fmt, ap);
+	printDiag("warning: ", fmt, ap);
 	va_end(ap);
-	putc('\n', stderr);
 }
 
 void error(char const *fmt, ...) {
 	va_list ap;
 
-	fputs("error: ", stderr);
 	va_start(ap, fmt);
-	vfprintf(stderr, fmt, ap);
+	printDiag("error: ", fmt, ap);
 	va_end(ap);
-	putc('\n', stderr);
 
 	if (nbErrors != std::numeric_limits<decltype(nbErrors)>::max())
 		nbErrors++;
@@ -85,11 +142,9 @@ void errorMessage(char const *msg) {
 [[noreturn]] void fatal(char const *fmt, ...) {
 	va_list ap;
 
-	fputs("FATAL: ", stderr);
 	va_start(ap, fmt);
-	vfprintf(stderr, fmt, ap);
+	printDiag("FATAL: ", fmt, ap);
 	va_end(ap);
-	putc('\n', stderr);
 
 	if (nbErrors != std::numeric_limits<decltype(nbErrors)>::max())
 		nbErrors++;
@@ -108,7 +163,7 @@ void Options::verbosePrint(uint8_t level, char const *fmt, ...) const {
 }
 
 // Short options
-static char const *optstring = "-Aa:b:Cc:Dd:Ffhi:L:mN:n:Oo:Pp:Qq:r:s:Tt:U:uVvx:Z";
+static char const *optstring = "-Aa:B:b:Cc:Dd:Ffhi:j:L:mN:n:Oo:Pp:Qq:r:s:Tt:U:uVvx:Z";
 
 /*
  * Equivalent long options
@@ -123,11 +178,13 @@ static char const *optstring = "-Aa:b:Cc:Dd:Ffhi:L:mN:n:Oo:Pp:Qq:r:s:Tt:U:uVvx:Z
 static option const longopts[] = {
     {"auto-attr-map",    no_argument,       nullptr, 'A'},
     {"attr-map",         required_argument, nullptr, 'a'},
+    {"batch",            required_argument, nullptr, 'B'},
     {"base-tiles",       required_argument, nullptr, 'b'},
     {"color-curve",      no_argument,       nullptr, 'C'},
     {"colors",           required_argument, nullptr, 'c'},
     {"depth",            required_argument, nullptr, 'd'},
     {"input-tileset",    required_argument, nullptr, 'i'},
+    {"jobs",             required_argument, nullptr, 'j'},
     {"slice",            required_argument, nullptr, 'L'},
     {"mirror-tiles",     no_argument,       nullptr, 'm'},
     {"nb-tiles",         required_argument, nullptr, 'N'},
@@ -155,10 +212,11 @@ static option const longopts[] = {
 static void printUsage() {
 	fputs(
 	    "Usage: rgbgfx [-r stride] [-CmOuVXYZ] [-v [-v ...]] [-a <attr_map> | -A]\n"
-	    "       [-b <base_ids>] [-c <colors>] [-d <depth>] [-i <tileset_file>]\n"
-	    "       [-L <slice>] [-N <nb_tiles>] [-n <nb_pals>] [-o <out_file>]\n"
-	    "       [-p <pal_file> | -P] [-q <pal_map> | -Q] [-s <nb_colors>]\n"
-	    "       [-t <tile_map> | -T] [-x <nb_tiles>] <file>\n"
+	    "       [-B <batch_file>] [-b <base_ids>] [-c <colors>] [-d <depth>]\n"
+	    "       [-i <tileset_file>] [-j <nb_threads>] [-L <slice>] [-N <nb_tiles>]\n"
+	    "       [-n <nb_pals>] [-o <out_file>] [-p <pal_file> | -P]\n"
+	    "       [-q <pal_map> | -Q] [-s <nb_colors>] [-t <tile_map> | -T]\n"
+	    "       [-x <nb_tiles>] <file>\n"
 	    "Useful options:\n"
 	    "    -m, --mirror-tiles    optimize out mirrored tiles\n"
 	    "    -o, --output <path>   output the tile data to this path\n"
@@ -273,8 +331,11 @@ static void registerInput(char const *arg) {
 /*
  * Turn an "at-file"'s contents into an argv that `getopt` can handle
  * @param argPool Argument characters will be appended to this vector, for storage purposes.
+ * @param lineStarts If not null, the index of each line's first argument is appended to it.
  */
-static std::vector<size_t> readAtFile(std::string const &path, std::vector<char> &argPool) {
+static std::vector<size_t> readAtFile(
+    std::string const &path, std::vector<char> &argPool, std::vector<size_t> *lineStarts = nullptr
+) {
 	File file;
 	if (!file.open(path, std::ios_base::in)) {
 		fatal("Error reading @%s: %s", file.c_str(path), strerror(errno));
@@ -315,6 +376,9 @@ static std::vector<size_t> readAtFile(std::string const &path, std::vector<char>
 		}
 
 		// Alright, now we can parse the line
+		if (lineStarts) {
+			lineStarts->push_back(argvOfs.size());
+		}
 		do {
 			// Read one argument (until the next whitespace char).
 			// We know there is one because we already have its first character in `c`.
@@ -366,6 +430,15 @@ static char *parseArgv(int argc, char *argv[]) {
 				warning("Overriding attrmap file %s", options.attrmap.c_str());
 			options.attrmap = musl_optarg;
 			break;
+		case 'B':
+			if (isParsingBatchJob) {
+				error("Batch jobs cannot themselves use batch files (-B)");
+			} else {
+				if (batchFileName)
+					warning("Overriding batch file %s", batchFileName);
+				batchFileName = musl_optarg;
+			}
+			break;
 		case 'b':
 			number = parseNumber(arg, "Bank 0 base tile ID", 0);
 			if (number >= 256) {
@@ -434,6 +507,15 @@ static char *parseArgv(int argc, char *argv[]) {
 				warning("Overriding input tileset file %s", options.inputTileset.c_str());
 			options.inputTileset = musl_optarg;
 			break;
+		case 'j':
+			options.nbThreads = parseNumber(arg, "Number of threads", 1);
+			if (*arg != '\0') {
+				error("Number of threads (-j) must be a valid number, not \"%s\"", musl_optarg);
+				options.nbThreads = 1;
+			} else if (options.nbThreads == 0) {
+				options.nbThreads = defaultNbThreads();
+			}
+			break;
 		case 'L':
 			options.inputSlice.left = parseNumber(arg, "Input slice left coordinate");
 			if (options.inputSlice.left > INT16_MAX) {
@@ -620,7 +702,10 @@ static char *parseArgv(int argc, char *argv[]) {
 	return nullptr; // Done processing this argv
 }
 
-int main(int argc, char *argv[]) {
+/*
+ * Parses an arg vector, as well as any at-files it references.
+ */
+static void parseArgs(int argc, char *argv[]) {
 	struct AtFileStackEntry {
 		int parentInd;            // Saved offset into parent argv
 		std::vector<char *> argv; // This context's arg pointer vec
@@ -684,7 +769,12 @@ int main(int argc, char *argv[]) {
 			curArgv = vec.data();
 		}
 	}
+}
 
+/*
+ * Processes the options that depend on others, now that they have all been parsed.
+ */
+static void finishOptions() {
 	if (options.nbColorsPerPal == 0) {
 		options.nbColorsPerPal = 1u << options.bitDepth;
 	} else if (options.nbColorsPerPal > 1u << options.bitDepth) {
@@ -737,8 +827,8 @@ int main(int argc, char *argv[]) {
 	autoOutPath(localOptions.autoPalmap, options.palmap, ".palmap");
 
 	// Execute deferred external pal spec parsing, now that all other params are known
-	if (localOptions.externalPalSpec) {
-		parseExternalPalSpec(localOptions.externalPalSpec);
+	if (!localOptions.externalPalSpec.empty()) {
+		parseExternalPalSpec(localOptions.externalPalSpec.c_str());
 	}
 
 	if (options.verbosity >= Options::VERB_CFG) {
@@ -784,6 +874,8 @@ int main(int argc, char *argv[]) {
 		if (options.useColorCurve)
 			fputs("\tUse color curve\n", stderr);
 		fprintf(stderr, "\tBit depth: %" PRIu8 "bpp\n", options.bitDepth);
+		if (options.nbThreads != 1)
+			fprintf(stderr, "\tUse up to %" PRIu16 " threads\n", options.nbThreads);
 		if (options.trim != 0)
 			fprintf(stderr, "\tTrim the last %" PRIu64 " tiles\n", options.trim);
 		fprintf(stderr, "\tMaximum %" PRIu16 " palettes\n", options.nbPalettes);
@@ -847,10 +939,9 @@ int main(int argc, char *argv[]) {
 		printPath("Output palettes", options.palettes);
 		fputs("Ready.\n", stderr);
 	}
+}
 
-	// Do not do anything if option parsing went wrong.
-	requireZeroErrors();
-
+static void runJob() {
 	if (!options.input.empty()) {
 		if (localOptions.reverse) {
 			reverse();
@@ -865,6 +956,108 @@ int main(int argc, char *argv[]) {
 		printUsage();
 		exit(1);
 	}
+}
+
+struct BatchJob {
+	Options options;
+	LocalOptions localOptions;
+};
+
+/*
+ * Converts each image listed in the batch file, using the command-line options as defaults.
+ * Each line is parsed like an at-file, and is an independent job; jobs are run concurrently.
+ */
+static void runBatch() {
+	if (!options.input.empty()) {
+		fprintf(stderr, "FATAL: input image cannot be specified along with a batch file\n");
+		printUsage();
+		exit(1);
+	}
+
+	std::vector<char> argPool;
+	std::vector<size_t> lineStarts;
+	std::vector<size_t> offsets = readAtFile(batchFileName, argPool, &lineStarts);
+	lineStarts.push_back(offsets.size());
+
+	// Parse all jobs up front, since option parsing is not thread-safe
+	Options const defaultOptions = options;
+	LocalOptions const defaultLocalOptions = localOptions;
+	std::vector<BatchJob> jobs;
+	jobs.reserve(lineStarts.size() - 1);
+	isParsingBatchJob = true;
+	for (size_t line = 0; line + 1 < lineStarts.size(); ++line) {
+		// Copy the batch file's name as `argv[0]`, for error reporting
+		std::vector<char *> jobArgv{const_cast<char *>(batchFileName)};
+		for (size_t i = lineStarts[line]; i < lineStarts[line + 1]; ++i) {
+			jobArgv.push_back(&argPool.data()[offsets[i]]);
+		}
+		jobArgv.push_back(nullptr);
+
+		options = defaultOptions;
+		localOptions = defaultLocalOptions;
+		musl_optind = 1;
+		parseArgs(jobArgv.size() - 1, jobArgv.data());
+		if (options.input.empty())
+			error("No input image specified for batch job #%zu", line + 1);
+		jobs.push_back({.options = std::move(options), .localOptions = std::move(localOptions)});
+	}
+	isParsingBatchJob = false;
+
+	// Do not do anything if option parsing went wrong.
+	requireZeroErrors();
+
+	// Unlike `parallelFor`, the main thread does not run jobs itself, since the workers must all
+	// know when the others are done, in case one of their jobs fails (see `failBatchJob`)
+	size_t nbWorkers = std::min<size_t>(defaultNbThreads(), jobs.size());
+	BatchState state;
+	state.nbWorkersRunning = nbWorkers;
+	batch = &state;
+
+	std::atomic_size_t nextJob = 0;
+	auto work = [&jobs, &nextJob]() {
+		isBatchWorker = true;
+		for (size_t i; !batch->failed && (i = nextJob.fetch_add(1)) < jobs.size();) {
+			options = std::move(jobs[i].options);
+			localOptions = std::move(jobs[i].localOptions);
+
+			finishOptions();
+			requireZeroErrors();
+			runJob();
+			requireZeroErrors();
+		}
+
+		std::unique_lock lock(batch->mutex);
+		--batch->nbWorkersRunning;
+		batch->workerStopped.notify_all();
+		// Wait for the other workers; if a job fails, its thread exits, so do not return then,
+		// which would leave this thread finished but never joined
+		batch->workerStopped.wait(lock, [] {
+			return batch->nbWorkersRunning == 0 && !batch->failed;
+		});
+	};
+
+	// If any job fails, the process exits from its thread once all jobs already started are done
+	std::vector<std::thread> workers;
+	workers.reserve(nbWorkers);
+	for (size_t i = 0; i < nbWorkers; i++)
+		workers.emplace_back(work);
+	for (std::thread &worker : workers)
+		worker.join();
+}
+
+int main(int argc, char *argv[]) {
+	parseArgs(argc, argv);
+
+	if (batchFileName) {
+		runBatch();
+		return 0;
+	}
+
+	finishOptions();
+	// Do not do anything if option parsing went wrong.
+	requireZeroErrors();
+
+	runJob();
 
 	requireZeroErrors();
 	return 0;
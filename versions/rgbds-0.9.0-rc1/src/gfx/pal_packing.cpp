@@ -186,7 +186,7 @@ private:
 		// > optionally add one to your count, increment the iterator and push it back into the
 		// > queue if it didn't reach the end
 		// > And you do this until the priority queue is empty
-		static std::unordered_set<uint16_t> colors;
+		static thread_local std::unordered_set<uint16_t> colors;
 
 		colors.clear();
 		addUniqueColors(colors, RANGE(*this), *_protoPals);
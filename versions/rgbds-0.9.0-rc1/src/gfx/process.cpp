@@ -11,14 +11,18 @@
 #include <stdio.h>
 #include <string.h>
 #include <tuple>
-#include <unordered_set>
+#include <unordered_map>
 #include <utility>
 #include <vector>
+#ifdef __SSE2__
+	#include <emmintrin.h>
+#endif
 
 #include "defaultinitalloc.hpp"
 #include "file.hpp"
 #include "helpers.hpp"
 #include "itertools.hpp"
+#include "parallel.hpp"
 
 #include "gfx/main.hpp"
 #include "gfx/pal_packing.hpp"
@@ -443,6 +447,8 @@ public:
 			Rgba pixel(uint32_t xOfs, uint32_t yOfs) const {
 				return _png.pixel(x + xOfs, y + yOfs);
 			}
+			// The 8 pixels of one of the tile's rows are contiguous
+			Rgba const *row(uint32_t yOfs) const { return &_png.pixel(x, y + yOfs); }
 		};
 
 	private:
@@ -483,6 +489,16 @@ public:
 			iterator it{*this, _limit, _width - 8, _height - 8}; // Last valid one...
 			return ++it;                                         // ...now one-past-last!
 		}
+
+		size_t size() const { return static_cast<size_t>(_width / 8) * (_height / 8); }
+		// How many tiles are visited before moving to the next row (or column, with `-Z`)
+		uint32_t tilesPerLine() const { return _limit / 8; }
+		// Returns the same tile as advancing `begin()` that many times
+		Tile operator[](size_t index) const {
+			uint32_t major = index % tilesPerLine() * 8, minor = index / tilesPerLine() * 8;
+			auto [x, y] = _columnMajor ? std::pair{minor, major} : std::pair{major, minor};
+			return {_png, x + options.inputSlice.left, y + options.inputSlice.top};
+		}
 	};
 public:
 	TilesVisitor visitAsTiles() const {
@@ -624,7 +640,7 @@ static std::tuple<DefaultInitVec<size_t>, std::vector<Palette>>
 	}
 
 	auto listColors = [](auto const &list) {
-		static char buf[sizeof(", $XXXX, $XXXX, $XXXX, $XXXX")];
+		static thread_local char buf[sizeof(", $XXXX, $XXXX, $XXXX, $XXXX")];
 		char *ptr = buf;
 		for (uint16_t cgbColor : list) {
 			ptr += snprintf(ptr, sizeof(", $XXXX"), ", $%04x", cgbColor);
@@ -705,69 +721,193 @@ static void outputPalettes(std::vector<Palette> const &palettes) {
 	}
 }
 
-static void hashBitplanes(uint16_t bitplanes, uint16_t &hash) {
-	hash ^= bitplanes;
-	if (options.allowMirroringX) {
-		// Count the line itself as mirrored, which ensures the same hash as the tile's horizontal
-		// flip; vertical mirroring is already taken care of because the symmetric line will be
-		// XOR'd the same way. (This can trivially create some collisions, but real-world tile data
-		// generally doesn't trigger them.)
-		hash ^= flipTable[bitplanes >> 8] << 8 | flipTable[bitplanes & 0xFF];
+/*
+ * Calls `func(begin, end)` for consecutive bands of whole tile rows (or columns, with `-Z`),
+ * covering all of the tiles' indices, spread across up to `-j` threads.
+ * The bands may be processed in any order, so `func` should only write to its own tiles' data.
+ */
+template<typename F>
+static void forEachTileBand(Png::TilesVisitor const &tiles, F const &func) {
+	size_t nbTiles = tiles.size();
+	if (nbTiles == 0) {
+		return;
 	}
+	size_t nbLines = nbTiles / tiles.tilesPerLine();
+	// Use several bands per thread, so that they still balance out if some are slower
+	size_t nbBands = std::min<size_t>(options.nbThreads == 1 ? 1 : options.nbThreads * 4, nbLines);
+	size_t bandSize = nbBands == 0 ? 0 : (nbLines + nbBands - 1) / nbBands * tiles.tilesPerLine();
+
+	Options const &jobOptions = options;
+	parallelFor(nbBands, options.nbThreads, [&](size_t band) {
+		// Other threads have their own `options`, so give them this job's, once per thread
+		static thread_local Options const *copiedOptions = nullptr;
+		if (&options != &jobOptions && copiedOptions != &jobOptions) {
+			options = jobOptions;
+			copiedOptions = &jobOptions;
+		}
+		size_t begin = band * bandSize;
+		if (begin < nbTiles) {
+			func(begin, std::min(begin + bandSize, nbTiles));
+		}
+	});
 }
 
-class TileData {
-	std::array<uint8_t, 16> _data;
-	// The hash is a bit lax: it's the XOR of all lines, and every other nibble is identical
-	// if horizontal mirroring is in effect. It should still be a reasonable tie-breaker in
-	// non-pathological cases.
-	uint16_t _hash;
-public:
-	// This is an index within the "global" pool; no bank info is encoded here
-	// It's marked as `mutable` so that it can be modified even on a `const` object;
-	// this is necessary because the `set` in which it's inserted refuses any modification for fear
-	// of altering the element's hash, but the tile ID is not part of it.
-	mutable uint16_t tileID;
-
-	static uint16_t
-	    rowBitplanes(Png::TilesVisitor::Tile const &tile, Palette const &palette, uint32_t y) {
-		uint16_t row = 0;
-		for (uint32_t x = 0; x < 8; ++x) {
-			row <<= 1;
-			uint8_t index = palette.indexOf(tile.pixel(x, y).cgbColor());
-			assume(index < palette.size()); // The color should be in the palette
-			if (index & 1) {
-				row |= 1;
+/*
+ * Converts rows of a tile's pixels to bitplanes.
+ * Each palette gets a lookup table from CGB colors to color indices up front, instead of
+ * searching the palette for every pixel; this also lets several threads share an encoder.
+ */
+class TileEncoder {
+	std::vector<Palette> const &_palettes;
+	// Indexed by CGB color, including `Rgba::transparent`
+	std::vector<std::vector<uint8_t>> _colorIndices;
+
+	static void cgbColors(Rgba const *pixels, std::array<uint32_t, 8> &colors) {
+#ifdef __SSE2__
+		if (!options.useColorCurve) {
+			// Pixels are stored as R, G, B, A bytes, so each one reads as a little-endian 0xAABBGGRR
+			for (size_t i = 0; i < 8; i += 4) {
+				__m128i rgba = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&pixels[i]));
+				__m128i red = _mm_and_si128(_mm_srli_epi32(rgba, 3), _mm_set1_epi32(0x001F));
+				__m128i green = _mm_and_si128(_mm_srli_epi32(rgba, 6), _mm_set1_epi32(0x03E0));
+				__m128i blue = _mm_and_si128(_mm_srli_epi32(rgba, 9), _mm_set1_epi32(0x7C00));
+				__m128i color = _mm_or_si128(_mm_or_si128(red, green), blue);
+				// Any pixel that isn't transparent has already been checked to be opaque
+				__m128i isTransparent = _mm_cmplt_epi32(
+				    _mm_srli_epi32(rgba, 24), _mm_set1_epi32(Rgba::transparency_threshold)
+				);
+				color = _mm_or_si128(
+				    _mm_andnot_si128(isTransparent, color),
+				    _mm_and_si128(isTransparent, _mm_set1_epi32(Rgba::transparent))
+				);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(&colors[i]), color);
 			}
-			if (index & 2) {
-				row |= 0x100;
+			return;
+		}
+#endif
+		// The color curve is expensive to compute, and pixels tend to repeat
+		for (size_t i = 0; i < 8; ++i) {
+			colors[i] = i != 0 && pixels[i] == pixels[i - 1] ? colors[i - 1] : pixels[i].cgbColor();
+		}
+	}
+
+public:
+	explicit TileEncoder(std::vector<Palette> const &palettes)
+	    : _palettes(palettes), _colorIndices(palettes.size()) {
+		for (size_t palID = 0; palID < palettes.size(); ++palID) {
+			Palette const &palette = palettes[palID];
+			std::vector<uint8_t> &indices = _colorIndices[palID];
+			indices.assign(Rgba::transparent + 1, UINT8_MAX); // Colors not in the palette
+			indices[Rgba::transparent] = palette.indexOf(Rgba::transparent);
+			for (uint16_t color : palette) {
+				if (color < Rgba::transparent && indices[color] == UINT8_MAX) {
+					indices[color] = palette.indexOf(color);
+				}
 			}
 		}
-		return row;
 	}
 
-	TileData(std::array<uint8_t, 16> &&raw) : _data(raw), _hash(0) {
-		for (uint8_t y = 0; y < 8; ++y) {
-			uint16_t bitplanes = _data[y * 2] | _data[y * 2 + 1] << 8;
-			hashBitplanes(bitplanes, _hash);
+	/*
+	 * Returns the row's bitplane 0 in the low byte, and its bitplane 1 in the high byte
+	 */
+	uint16_t rowBitplanes(Png::TilesVisitor::Tile const &tile, size_t palID, uint32_t y) const {
+		std::array<uint32_t, 8> colors;
+		cgbColors(tile.row(y), colors);
+
+		std::vector<uint8_t> const &indices = _colorIndices[palID];
+		// Store the leftmost pixel last, as it is the most significant bit of each bitplane
+		alignas(8) std::array<uint8_t, 8> rowIndices;
+		for (size_t x = 0; x < 8; ++x) {
+			uint8_t index = indices[colors[x]];
+			assume(index < _palettes[palID].size()); // The color should be in the palette
+			rowIndices[7 - x] = index;
+		}
+
+#ifdef __SSE2__
+		// Move each bit to the top of its byte, and gather those of all 8 pixels at once
+		__m128i row = _mm_loadl_epi64(reinterpret_cast<__m128i const *>(rowIndices.data()));
+		uint8_t bitplane0 = _mm_movemask_epi8(_mm_slli_epi16(row, 7));
+		uint8_t bitplane1 = _mm_movemask_epi8(_mm_slli_epi16(row, 6));
+		return bitplane0 | bitplane1 << 8;
+#else
+		uint16_t bitplanes = 0;
+		for (size_t x = 8; x--;) {
+			bitplanes <<= 1;
+			bitplanes |= (rowIndices[x] & 1) | (rowIndices[x] & 2) << 7;
 		}
+		return bitplanes;
+#endif
 	}
+};
 
-	TileData(Png::TilesVisitor::Tile const &tile, Palette const &palette) : _hash(0) {
+class TileData {
+	std::array<uint8_t, 16> _data{};
+	// The hash of the tile's canonical form, so that all tiles which would be deduplicated
+	// together (see `tryMatching`) have the same hash.
+	uint64_t _hash;
+
+	// The canonical form is the lexicographically smallest of the tile's allowed flips
+	static std::array<uint8_t, 16> canonicalForm(std::array<uint8_t, 16> const &data) {
+		std::array<uint8_t, 16> canonical = data;
+		std::array<uint8_t, 16> flipped;
+		auto tryFlip = [&](auto getByte) {
+			for (uint8_t i = 0; i < flipped.size(); ++i) {
+				flipped[i] = getByte(i);
+			}
+			if (flipped < canonical) {
+				canonical = flipped;
+			}
+		};
+
+		if (options.allowMirroringX) {
+			tryFlip([&](uint8_t i) { return flipTable[data[i]]; });
+		}
+		if (options.allowMirroringY) {
+			// Flip the bottom bit to get the corresponding row's bitplane 0/1, like `tryMatching`
+			tryFlip([&](uint8_t i) { return data[(15 - i) ^ 1]; });
+			if (options.allowMirroringX) {
+				tryFlip([&](uint8_t i) { return flipTable[data[(15 - i) ^ 1]]; });
+			}
+		}
+		return canonical;
+	}
+
+	void computeHash() {
+		std::array<uint8_t, 16> canonical = canonicalForm(_data);
+		uint64_t lo, hi;
+		memcpy(&lo, &canonical[0], sizeof(lo));
+		memcpy(&hi, &canonical[8], sizeof(hi));
+
+		// Mix both halves, then use MurmurHash3's 64-bit finalizer to spread the bits around
+		_hash = lo * 0x9E37'79B9'7F4A'7C15 ^ (hi + 0x632B'E59B'D9B4'E019);
+		_hash ^= _hash >> 33;
+		_hash *= 0xFF51'AFD7'ED55'8CCD;
+		_hash ^= _hash >> 33;
+		_hash *= 0xC4CE'B9FE'1A85'EC53;
+		_hash ^= _hash >> 33;
+	}
+
+public:
+	// This is an index within the "global" pool; no bank info is encoded here
+	uint16_t tileID;
+
+	TileData(std::array<uint8_t, 16> &&raw) : _data(raw) { computeHash(); }
+
+	TileData(Png::TilesVisitor::Tile const &tile, TileEncoder const &encoder, size_t palID) {
 		size_t writeIndex = 0;
 		for (uint32_t y = 0; y < 8; ++y) {
-			uint16_t bitplanes = rowBitplanes(tile, palette, y);
-			hashBitplanes(bitplanes, _hash);
+			uint16_t bitplanes = encoder.rowBitplanes(tile, palID, y);
 
 			_data[writeIndex++] = bitplanes & 0xFF;
 			if (options.bitDepth == 2) {
 				_data[writeIndex++] = bitplanes >> 8;
 			}
 		}
+		computeHash();
 	}
 
 	auto const &data() const { return _data; }
-	uint16_t hash() const { return _hash; }
+	uint64_t hash() const { return _hash; }
 
 	enum MatchType {
 		NOPE,
@@ -826,14 +966,6 @@ public:
 
 		return MatchType::NOPE;
 	}
-	friend bool operator==(TileData const &lhs, TileData const &rhs) {
-		return lhs.tryMatching(rhs) != MatchType::NOPE;
-	}
-};
-
-template<>
-struct std::hash<TileData> {
-	std::size_t operator()(TileData const &tile) const { return tile.hash(); }
 };
 
 namespace unoptimized {
@@ -858,23 +990,26 @@ static void outputTileData(
 	}
 	remainingTiles -= options.trim;
 
-	for (auto [tile, attr] : zip(png.visitAsTiles(), attrmap)) {
-		// If the tile is fully transparent, default to palette 0
-		Palette const &palette = palettes[attr.getPalID(mappings)];
-		for (uint32_t y = 0; y < 8; ++y) {
-			uint16_t bitplanes = TileData::rowBitplanes(tile, palette, y);
-			output->sputc(bitplanes & 0xFF);
-			if (options.bitDepth == 2) {
-				output->sputc(bitplanes >> 8);
+	// Encode all tiles first, so that it can be done in parallel
+	TileEncoder encoder(palettes);
+	auto tiles = png.visitAsTiles();
+	size_t const tileSize = options.bitDepth * 8;
+	DefaultInitVec<uint8_t> data(remainingTiles * tileSize);
+	forEachTileBand(tiles, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end && i < remainingTiles; ++i) {
+			// If the tile is fully transparent, default to palette 0
+			size_t palID = attrmap[i].getPalID(mappings);
+			uint8_t *ptr = &data[i * tileSize];
+			for (uint32_t y = 0; y < 8; ++y) {
+				uint16_t bitplanes = encoder.rowBitplanes(tiles[i], palID, y);
+				*ptr++ = bitplanes & 0xFF;
+				if (options.bitDepth == 2) {
+					*ptr++ = bitplanes >> 8;
+				}
 			}
 		}
-
-		--remainingTiles;
-		if (remainingTiles == 0) {
-			break;
-		}
-	}
-	assume(remainingTiles == 0);
+	});
+	output->sputn(reinterpret_cast<char const *>(data.data()), data.size());
 }
 
 static void outputMaps(
@@ -921,12 +1056,13 @@ static void outputMaps(
 namespace optimized {
 
 struct UniqueTiles {
-	std::unordered_set<TileData> tileset;
-	std::vector<TileData const *> tiles;
+	std::vector<TileData> tiles;
+	// Open-addressing hash table of indices into `tiles`, plus one; 0 marks an empty slot.
+	// Its size is always a power of 2, and it is kept at most half full.
+	std::vector<uint32_t> slots = std::vector<uint32_t>(1024, 0);
 
 	UniqueTiles() = default;
-	// Copies are likely to break pointers, so we really don't want those.
-	// Copy elision should be relied on to be more sure that refs won't be invalidated, too!
+	// Copies are expensive, so we really don't want those.
 	UniqueTiles(UniqueTiles const &) = delete;
 	UniqueTiles(UniqueTiles &&) = default;
 
@@ -934,24 +1070,46 @@ struct UniqueTiles {
 	 * Adds a tile to the collection, and returns its ID
 	 */
 	std::tuple<uint16_t, TileData::MatchType> addTile(TileData newTile) {
-		auto [tileData, inserted] = tileset.insert(newTile);
-
-		TileData::MatchType matchType = TileData::NOPE;
-		if (inserted) {
-			// Give the new tile the next available unique ID
-			tileData->tileID = static_cast<uint16_t>(tiles.size());
-			// Pointers are never invalidated!
-			tiles.emplace_back(&*tileData);
-		} else {
-			matchType = tileData->tryMatching(newTile);
+		size_t mask = slots.size() - 1;
+		size_t i = newTile.hash() & mask;
+		for (; slots[i] != 0; i = (i + 1) & mask) {
+			TileData const &tileData = tiles[slots[i] - 1];
+			if (tileData.hash() == newTile.hash()) {
+				// Tiles with the same canonical form match, so this only fails on hash collisions
+				if (TileData::MatchType matchType = tileData.tryMatching(newTile);
+				    matchType != TileData::NOPE) {
+					return {tileData.tileID, matchType};
+				}
+			}
+		}
+
+		// Give the new tile the next available unique ID
+		newTile.tileID = static_cast<uint16_t>(tiles.size());
+		tiles.push_back(newTile);
+		slots[i] = tiles.size();
+		if (tiles.size() * 2 > slots.size()) {
+			grow();
 		}
-		return {tileData->tileID, matchType};
+		return {newTile.tileID, TileData::NOPE};
 	}
 
 	auto size() const { return tiles.size(); }
 
 	auto begin() const { return tiles.begin(); }
 	auto end() const { return tiles.end(); }
+
+private:
+	void grow() {
+		slots.assign(slots.size() * 2, 0);
+		size_t mask = slots.size() - 1;
+		for (size_t id = 0; id < tiles.size(); ++id) {
+			size_t i = tiles[id].hash() & mask;
+			while (slots[i] != 0) {
+				i = (i + 1) & mask;
+			}
+			slots[i] = id + 1;
+		}
+	}
 };
 
 /*
@@ -1011,8 +1169,20 @@ static UniqueTiles dedupTiles(
 		}
 	}
 
-	for (auto [tile, attr] : zip(png.visitAsTiles(), attrmap)) {
-		auto [tileID, matchType] = tiles.addTile({tile, palettes[mappings[attr.protoPaletteID]]});
+	// Encode and hash all tiles first, so that it can be done in parallel;
+	// then add them in order, so that they get the same IDs regardless
+	TileEncoder encoder(palettes);
+	auto imageTiles = png.visitAsTiles();
+	std::vector<std::optional<TileData>> tileData(imageTiles.size());
+	forEachTileBand(imageTiles, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			// If the tile is fully transparent, default to palette 0
+			tileData[i].emplace(imageTiles[i], encoder, attrmap[i].getPalID(mappings));
+		}
+	});
+
+	for (auto [tile, data, attr] : zip(imageTiles, tileData, attrmap)) {
+		auto [tileID, matchType] = tiles.addTile(*data);
 
 		if (matchType == TileData::NOPE && options.output.empty()) {
 			error(
@@ -1030,7 +1200,7 @@ static UniqueTiles dedupTiles(
 		    (attr.bank ? tileID - options.maxNbTiles[0] : tileID) + options.baseTileIDs[attr.bank];
 	}
 
-	// Copy elision should prevent the contained `unordered_set` from being re-constructed
+	// Copy elision should prevent the contained vectors from being re-constructed
 	return tiles;
 }
 
@@ -1042,10 +1212,10 @@ static void outputTileData(UniqueTiles const &tiles) {
 
 	uint16_t tileID = 0;
 	for (auto iter = tiles.begin(), end = tiles.end() - options.trim; iter != end; ++iter) {
-		TileData const *tile = *iter;
-		assume(tile->tileID == tileID);
+		TileData const &tile = *iter;
+		assume(tile.tileID == tileID);
 		++tileID;
-		output->sputn(reinterpret_cast<char const *>(tile->data().data()), options.bitDepth * 8);
+		output->sputn(reinterpret_cast<char const *>(tile.data().data()), options.bitDepth * 8);
 	}
 }
 
@@ -1101,6 +1271,92 @@ void processPalettes() {
 	outputPalettes(palettes);
 }
 
+/*
+ * Finds the first proto-palette that a tile's colors are a subset or a superset of, without
+ * comparing them to every proto-palette.
+ * This relies on proto-palettes only ever being replaced by supersets of themselves.
+ */
+class ProtoPaletteIndex {
+	// A sorted set of colors, packed 16 bits per color like a `ProtoPalette`'s `_colorIndices`
+	using Key = uint64_t;
+
+	// For each set of colors, the lowest ID of the proto-palettes that contain it;
+	// since proto-palettes only grow, those can never stop containing it
+	std::unordered_map<Key, size_t> _supersets;
+	// For each set of colors, the IDs of the proto-palettes that are exactly it
+	std::unordered_map<Key, std::vector<size_t>> _exact;
+
+	static Key makeKey(std::array<uint16_t, ProtoPalette::capacity> const &colors) {
+		Key key = 0;
+		for (size_t i = 0; i < colors.size(); ++i) {
+			key |= Key(colors[i]) << (16 * i);
+		}
+		return key;
+	}
+	static Key makeKey(ProtoPalette const &protoPal) {
+		std::array<uint16_t, ProtoPalette::capacity> colors;
+		colors.fill(UINT16_MAX);
+		std::copy(RANGE(protoPal), colors.begin());
+		return makeKey(colors);
+	}
+
+	// Calls `callback` with the key of each non-empty subset of the proto-palette (itself included)
+	template<typename F>
+	static void forEachSubset(ProtoPalette const &protoPal, F callback) {
+		size_t nbColors = protoPal.size();
+		for (unsigned mask = 1; mask < 1u << nbColors; ++mask) {
+			std::array<uint16_t, ProtoPalette::capacity> colors;
+			colors.fill(UINT16_MAX);
+			size_t nbPicked = 0;
+			for (size_t i = 0; i < nbColors; ++i) {
+				if (mask & 1u << i) {
+					colors[nbPicked++] = protoPal.begin()[i]; // This keeps the colors sorted
+				}
+			}
+			callback(makeKey(colors));
+		}
+	}
+
+public:
+	std::optional<size_t> find(ProtoPalette const &tileColors) const {
+		size_t id = SIZE_MAX;
+
+		// Proto-palettes that contain the tile's colors
+		if (auto search = _supersets.find(makeKey(tileColors)); search != _supersets.end()) {
+			id = search->second;
+		}
+		// Proto-palettes that are contained in the tile's colors
+		forEachSubset(tileColors, [&](Key key) {
+			if (auto search = _exact.find(key); search != _exact.end()) {
+				id = std::min(id, *std::min_element(RANGE(search->second)));
+			}
+		});
+
+		return id != SIZE_MAX ? std::optional(id) : std::nullopt;
+	}
+
+	void add(size_t id, ProtoPalette const &protoPal) {
+		_exact[makeKey(protoPal)].push_back(id);
+		forEachSubset(protoPal, [&](Key key) {
+			if (auto [search, inserted] = _supersets.try_emplace(key, id); !inserted) {
+				search->second = std::min(search->second, id);
+			}
+		});
+	}
+
+	void replace(size_t id, ProtoPalette const &oldPal, ProtoPalette const &newPal) {
+		auto search = _exact.find(makeKey(oldPal));
+		assume(search != _exact.end());
+		std::vector<size_t> &ids = search->second;
+		ids.erase(std::find(RANGE(ids), id));
+		if (ids.empty()) {
+			_exact.erase(search);
+		}
+		// The old proto-palette's subsets are the new one's too, so they can stay as they are
+		add(id, newPal);
+	}
+};
+
 void process() {
 	options.verbosePrint(Options::VERB_CFG, "Using libpng %s\n", png_get_libpng_ver(nullptr));
 
@@ -1127,24 +1383,35 @@ void process() {
 	// perform even if no output is requested), and because it's necessary to generate any
 	// output (with the exception of an un-duplicated tilemap, but that's an acceptable loss.)
 	std::vector<ProtoPalette> protoPalettes;
+	ProtoPaletteIndex protoPalIndex;
 	DefaultInitVec<AttrmapEntry> attrmap{};
 
-	for (auto tile : png.visitAsTiles()) {
-		ProtoPalette tileColors;
-		AttrmapEntry &attrs = attrmap.emplace_back();
-		uint8_t nbColorsInTile = 0;
-
-		for (uint32_t y = 0; y < 8; ++y) {
-			for (uint32_t x = 0; x < 8; ++x) {
-				Rgba color = tile.pixel(x, y);
-				if (!color.isTransparent()) { // Do not count transparency in for packing
-					// Add the color to the proto-pal (if not full), and count it if it was unique.
-					if (tileColors.add(color.cgbColor())) {
-						++nbColorsInTile;
+	// Gather each tile's colors first, so that it can be done in parallel;
+	// then add them in order, so that proto-palettes are numbered the same regardless
+	auto imageTiles = png.visitAsTiles();
+	std::vector<std::pair<ProtoPalette, uint8_t>> tileColorsAndCounts(imageTiles.size());
+	forEachTileBand(imageTiles, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			auto &[tileColors, nbColorsInTile] = tileColorsAndCounts[i];
+			nbColorsInTile = 0;
+			for (uint32_t y = 0; y < 8; ++y) {
+				for (uint32_t x = 0; x < 8; ++x) {
+					Rgba color = imageTiles[i].pixel(x, y);
+					if (!color.isTransparent()) { // Do not count transparency in for packing
+						// Add the color to the proto-pal (if not full), and count it if it was
+						// unique.
+						if (tileColors.add(color.cgbColor())) {
+							++nbColorsInTile;
+						}
 					}
 				}
 			}
 		}
+	});
+
+	for (auto [tile, colorsAndCount] : zip(imageTiles, tileColorsAndCounts)) {
+		auto &[tileColors, nbColorsInTile] = colorsAndCount;
+		AttrmapEntry &attrs = attrmap.emplace_back();
 
 		if (tileColors.empty()) {
 			// "Empty" proto-palettes screw with the packing process, so discard those
@@ -1153,10 +1420,10 @@ void process() {
 		}
 
 		// Insert the proto-palette, making sure to avoid overlaps
-		for (size_t n = 0; n < protoPalettes.size(); ++n) {
-			switch (tileColors.compare(protoPalettes[n])) {
-			case ProtoPalette::WE_BIGGER:
-				protoPalettes[n] = tileColors; // Override them
+		if (std::optional<size_t> n = protoPalIndex.find(tileColors); n) {
+			if (tileColors.compare(protoPalettes[*n]) == ProtoPalette::WE_BIGGER) {
+				protoPalIndex.replace(*n, protoPalettes[*n], tileColors);
+				protoPalettes[*n] = tileColors; // Override them
 				// Remove any other proto-palettes that we encompass
 				// (Example [(0, 1), (0, 2)], inserting (0, 1, 2))
 				/*
@@ -1171,16 +1438,10 @@ void process() {
 				 *     }
 				 * }
 				 */
-				[[fallthrough]];
-
-			case ProtoPalette::THEY_BIGGER:
-				// Do nothing, they already contain us
-				attrs.protoPaletteID = n;
-				goto continue_visiting_tiles; // Can't `continue` from within a nested loop
-
-			case ProtoPalette::NEITHER:
-				break; // Keep going
 			}
+			// Otherwise, do nothing, they already contain us
+			attrs.protoPaletteID = *n;
+			continue;
 		}
 
 		if (nbColorsInTile > options.maxOpaqueColors()) {
@@ -1201,8 +1462,8 @@ void process() {
 			    AttrmapEntry::transparent
 			);
 		}
+		protoPalIndex.add(protoPalettes.size(), tileColors);
 		protoPalettes.push_back(tileColors);
-continue_visiting_tiles:;
 	}
 
 	options.verbosePrint(
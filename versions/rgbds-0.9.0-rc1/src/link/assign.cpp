@@ -2,8 +2,10 @@
 
 #include "link/assign.hpp"
 
-#include <deque>
+#include <algorithm>
 #include <inttypes.h>
+#include <map>
+#include <set>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,26 +27,76 @@ struct MemoryLocation {
 	uint32_t bank;
 };
 
-struct FreeSpace {
-	uint16_t address;
-	uint16_t size;
+// Free space in a bank, indexed by address
+struct BankMemory {
+	std::map<uint16_t, uint16_t> freeSpaces; // Address -> size
+	std::multiset<uint16_t> sizes;           // The sizes of all free spaces
+
+	uint16_t largestFreeSpace() const { return sizes.empty() ? 0 : *sizes.rbegin(); }
+
+	void addFreeSpace(uint16_t address, uint16_t size) {
+		freeSpaces.emplace(address, size);
+		sizes.insert(size);
+	}
+
+	void removeFreeSpace(std::map<uint16_t, uint16_t>::iterator space) {
+		sizes.erase(sizes.find(space->second));
+		freeSpaces.erase(space);
+	}
+};
+
+// Max-tree of each bank's largest free space, to skip over banks that are too full
+class BankIndex {
+	size_t nbLeaves;
+	std::vector<uint16_t> tree; // `tree[1]` is the root, `tree[nbLeaves + i]` the bank #i
+
+	size_t findFirst(size_t node, size_t lo, size_t hi, size_t from, uint16_t size) const {
+		if (hi <= from || tree[node] < size)
+			return SIZE_MAX;
+		if (hi - lo == 1)
+			return lo;
+		size_t mid = (lo + hi) / 2;
+		if (size_t idx = findFirst(node * 2, lo, mid, from, size); idx != SIZE_MAX)
+			return idx;
+		return findFirst(node * 2 + 1, mid, hi, from, size);
+	}
+
+public:
+	void init(size_t nbBanks, uint16_t size) {
+		for (nbLeaves = 1; nbLeaves < nbBanks; nbLeaves *= 2)
+			;
+		tree.assign(nbLeaves * 2, 0);
+		for (size_t i = 0; i < nbBanks; i++)
+			update(i, size);
+	}
+
+	void update(size_t bankIdx, uint16_t largestFreeSpace) {
+		size_t node = nbLeaves + bankIdx;
+		tree[node] = largestFreeSpace;
+		for (node /= 2; node; node /= 2)
+			tree[node] = std::max(tree[node * 2], tree[node * 2 + 1]);
+	}
+
+	// Returns the index of the first bank at or after `from` with enough space, or SIZE_MAX
+	size_t findFirst(size_t from, uint16_t size) const {
+		return findFirst(1, 0, nbLeaves, from, size);
+	}
 };
 
 // Table of free space for each bank
-std::vector<std::deque<FreeSpace>> memory[SECTTYPE_INVALID];
+std::vector<BankMemory> memory[SECTTYPE_INVALID];
+static BankIndex bankIndex[SECTTYPE_INVALID];
 
 uint64_t nbSectionsToAssign;
+uint64_t nbFreeSpaceQueries;
 
 // Init the free space-modelling structs
 static void initFreeSpace() {
 	for (SectionType type : EnumSeq(SECTTYPE_INVALID)) {
 		memory[type].resize(nbbanks(type));
-		for (std::deque<FreeSpace> &bankMem : memory[type]) {
-			bankMem.push_back({
-			    .address = sectionTypeInfo[type].startAddr,
-			    .size = sectionTypeInfo[type].size,
-			});
-		}
+		for (BankMemory &bankMem : memory[type])
+			bankMem.addFreeSpace(sectionTypeInfo[type].startAddr, sectionTypeInfo[type].size);
+		bankIndex[type].init(nbbanks(type), sectionTypeInfo[type].size);
 	}
 }
 
@@ -67,37 +119,64 @@ static void assignSection(Section &section, MemoryLocation const &location) {
 }
 
 /*
- * Checks whether a given location is suitable for placing a given section
+ * Finds the lowest address in a bank where a section can be placed.
  * This checks not only that the location has enough room for the section, but
  * also that the constraints (alignment...) are respected.
  * @param section The section to be placed
- * @param freeSpace The candidate free space to place the section into
- * @param location The location to attempt placing the section at
- * @return True if the location is suitable, false otherwise.
+ * @param bankMem The bank's free space
+ * @param location A pointer to a memory location whose address will be filled
+ * @return True if a suitable location was found, false otherwise.
  */
-static bool isLocationSuitable(
-    Section const &section, FreeSpace const &freeSpace, MemoryLocation const &location
+static bool getPlacementInBank(
+    Section const &section, BankMemory const &bankMem, MemoryLocation &location
 ) {
-	if (section.isAddressFixed && section.org != location.address)
+	nbFreeSpaceQueries++;
+	if (bankMem.largestFreeSpace() < section.size)
 		return false;
 
-	if (section.isAlignFixed && ((location.address - section.alignOfs) & section.alignMask))
-		return false;
+	if (section.isAddressFixed) {
+		// If the address is fixed, there can be only one candidate free space per bank
+		auto space = bankMem.freeSpaces.upper_bound(section.org);
+		if (space == bankMem.freeSpaces.begin())
+			return false;
+		--space;
+		if (section.isAlignFixed && ((section.org - section.alignOfs) & section.alignMask))
+			return false;
+		if (section.org + section.size > space->first + space->second)
+			return false;
+		location.address = section.org;
+		return true;
+	}
 
-	if (location.address < freeSpace.address)
-		return false;
+	for (auto const &[address, size] : bankMem.freeSpaces) {
+		if (size < section.size)
+			continue;
 
-	return location.address + section.size <= freeSpace.address + freeSpace.size;
+		if (!section.isAlignFixed) {
+			// Any location is fine, so, the start of the free space
+			location.address = address;
+			return true;
+		}
+
+		// Go to the first aligned location in that free space
+		int32_t alignedAddr =
+		    ((address - section.alignOfs + section.alignMask) & ~section.alignMask)
+		    + section.alignOfs;
+		if (alignedAddr + section.size <= address + size) {
+			location.address = alignedAddr;
+			return true;
+		}
+	}
+	return false;
 }
 
 /*
  * Finds a suitable location to place a section at.
  * @param section The section to be placed
  * @param location A pointer to a memory location that will be filled
- * @return The index into `memory[section->type]` of the free space encompassing the location,
- *         or -1 if none was found
+ * @return True if a location was found, false otherwise.
  */
-static ssize_t getPlacement(Section const &section, MemoryLocation &location) {
+static bool getPlacement(Section const &section, MemoryLocation &location) {
 	SectionTypeInfo const &typeInfo = sectionTypeInfo[section.type];
 
 	static uint16_t curScrambleROM = 0;
@@ -124,83 +203,45 @@ static ssize_t getPlacement(Section const &section, MemoryLocation &location) {
 	}
 
 	for (;;) {
-		// Switch to the beginning of the next bank
-		std::deque<FreeSpace> &bankMem = memory[section.type][location.bank - typeInfo.firstBank];
-		size_t spaceIdx = 0;
-
-		if (spaceIdx < bankMem.size()) {
-			location.address = bankMem[spaceIdx].address;
-
-			// Process locations in that bank
-			while (spaceIdx < bankMem.size()) {
-				// If that location is OK, return it
-				if (isLocationSuitable(section, bankMem[spaceIdx], location))
-					return spaceIdx;
-
-				// Go to the next *possible* location
-				if (section.isAddressFixed) {
-					// If the address is fixed, there can be only
-					// one candidate block per bank; if we already
-					// reached it, give up.
-					if (location.address < section.org)
-						location.address = section.org;
-					else
-						break; // Try again in next bank
-				} else if (section.isAlignFixed) {
-					// Move to next aligned location
-					// Move back to alignment boundary
-					location.address -= section.alignOfs;
-					// Ensure we're there (e.g. on first check)
-					location.address &= ~section.alignMask;
-					// Go to next align boundary and add offset
-					location.address += section.alignMask + 1 + section.alignOfs;
-				} else {
-					// Any location is fine, so, next free block
-					spaceIdx++;
-					if (spaceIdx < bankMem.size())
-						location.address = bankMem[spaceIdx].address;
-				}
-
-				// If that location is past the current block's end,
-				// go forwards until that is no longer the case.
-				while (spaceIdx < bankMem.size()
-				       && location.address >= bankMem[spaceIdx].address + bankMem[spaceIdx].size)
-					spaceIdx++;
-
-				// Try again with the new location/free space combo
-			}
-		}
+		if (getPlacementInBank(
+		        section, memory[section.type][location.bank - typeInfo.firstBank], location
+		    ))
+			return true;
 
 		// Try again in the next bank, if one is available.
 		// Try scrambled banks in descending order until no bank in the scrambled range is
 		// available. Otherwise, try in ascending order.
 		if (section.isBankFixed) {
-			return -1;
+			return false;
 		} else if (scrambleROMX && section.type == SECTTYPE_ROMX && location.bank <= scrambleROMX) {
 			if (location.bank > typeInfo.firstBank)
 				location.bank--;
 			else if (scrambleROMX < typeInfo.lastBank)
 				location.bank = scrambleROMX + 1;
 			else
-				return -1;
+				return false;
 		} else if (scrambleWRAMX && section.type == SECTTYPE_WRAMX && location.bank <= scrambleWRAMX) {
 			if (location.bank > typeInfo.firstBank)
 				location.bank--;
 			else if (scrambleWRAMX < typeInfo.lastBank)
 				location.bank = scrambleWRAMX + 1;
 			else
-				return -1;
+				return false;
 		} else if (scrambleSRAM && section.type == SECTTYPE_SRAM && location.bank <= scrambleSRAM) {
 			if (location.bank > typeInfo.firstBank)
 				location.bank--;
 			else if (scrambleSRAM < typeInfo.lastBank)
 				location.bank = scrambleSRAM + 1;
 			else
-				return -1;
-		} else if (location.bank < typeInfo.lastBank) {
-			location.bank++;
+				return false;
+		} else if (size_t bankIdx = bankIndex[section.type].findFirst(
+		               location.bank - typeInfo.firstBank + 1, section.size
+		           );
+		           bankIdx < nbbanks(section.type)) {
+			// Skip directly to the next bank with a large enough free space
+			location.bank = typeInfo.firstBank + bankIdx;
 		} else {
-			return -1;
+			return false;
 		}
 	}
 }
@@ -228,40 +269,23 @@ static void placeSection(Section &section) {
 
 	// Place section using first-fit decreasing algorithm
 	// https://en.wikipedia.org/wiki/Bin_packing_problem#First-fit_algorithm
-	if (ssize_t spaceIdx = getPlacement(section, location); spaceIdx != -1) {
-		std::deque<FreeSpace> &bankMem =
-		    memory[section.type][location.bank - sectionTypeInfo[section.type].firstBank];
-		FreeSpace &freeSpace = bankMem[spaceIdx];
+	if (getPlacement(section, location)) {
+		size_t bankIdx = location.bank - sectionTypeInfo[section.type].firstBank;
+		BankMemory &bankMem = memory[section.type][bankIdx];
+		auto freeSpace = std::prev(bankMem.freeSpaces.upper_bound(location.address));
+		uint16_t spaceStart = freeSpace->first;
+		uint32_t spaceEnd = freeSpace->first + freeSpace->second;
 
 		assignSection(section, location);
 
-		// Update the free space
-		uint16_t sectionEnd = section.org + section.size;
-		bool noLeftSpace = freeSpace.address == section.org;
-		bool noRightSpace = freeSpace.address + freeSpace.size == sectionEnd;
-		if (noLeftSpace && noRightSpace) {
-			// The free space is entirely deleted
-			bankMem.erase(bankMem.begin() + spaceIdx);
-		} else if (!noLeftSpace && !noRightSpace) {
-			// The free space is split in two
-			// Append the new space after the original one
-			bankMem.insert(
-			    bankMem.begin() + spaceIdx + 1,
-			    {.address = sectionEnd,
-			     .size = (uint16_t)(freeSpace.address + freeSpace.size - sectionEnd)}
-			);
-			// **`freeSpace` cannot be reused from this point on, because `bankMem.insert`
-			// invalidates all references to itself!**
-
-			// Resize the original space (address is unmodified)
-			bankMem[spaceIdx].size = section.org - bankMem[spaceIdx].address;
-		} else {
-			// The amount of free spaces doesn't change: resize!
-			freeSpace.size -= section.size;
-			if (noLeftSpace)
-				// The free space is moved *and* resized
-				freeSpace.address += section.size;
-		}
+		// Update the free space, keeping whatever is left on either side of the section
+		uint32_t sectionEnd = section.org + section.size;
+		bankMem.removeFreeSpace(freeSpace);
+		if (spaceStart != section.org)
+			bankMem.addFreeSpace(spaceStart, section.org - spaceStart);
+		if (sectionEnd != spaceEnd)
+			bankMem.addFreeSpace(sectionEnd, spaceEnd - sectionEnd);
+		bankIndex[section.type].update(bankIdx, bankMem.largestFreeSpace());
 		return;
 	}
 
@@ -331,7 +355,7 @@ static void placeSection(Section &section) {
 #define BANK_CONSTRAINED  (1 << 2)
 #define ORG_CONSTRAINED   (1 << 1)
 #define ALIGN_CONSTRAINED (1 << 0)
-static std::deque<Section *> unassignedSections[1 << 3];
+static std::vector<Section *> unassignedSections[1 << 3];
 
 /*
  * Categorize a section depending on how constrained it is
@@ -349,17 +373,24 @@ static void categorizeSection(Section &section) {
 	else if (section.isAlignFixed)
 		constraints |= ALIGN_CONSTRAINED;
 
-	std::deque<Section *> &sections = unassignedSections[constraints];
-	auto pos = sections.begin();
-
-	// Insert section while keeping the list sorted by decreasing size
-	while (pos != sections.end() && (*pos)->size > section.size)
-		pos++;
-	sections.insert(pos, &section);
+	// The lists get sorted once all sections have been categorized
+	unassignedSections[constraints].push_back(&section);
 
 	nbSectionsToAssign++;
 }
 
+/*
+ * Sorts a list of sections by decreasing size.
+ * Sections of equal size are placed in reverse order of categorization.
+ * @param sections The list to sort
+ */
+static void sortSections(std::vector<Section *> &sections) {
+	std::reverse(sections.begin(), sections.end());
+	std::stable_sort(sections.begin(), sections.end(), [](Section const *a, Section const *b) {
+		return a->size > b->size;
+	});
+}
+
 void assign_AssignSections() {
 	verbosePrint("Beginning assignment...\n");
 
@@ -370,6 +401,8 @@ void assign_AssignSections() {
 	// Generate linked lists of sections to assign
 	nbSectionsToAssign = 0;
 	sect_ForEach(categorizeSection);
+	for (std::vector<Section *> &sections : unassignedSections)
+		sortSections(sections);
 
 	// Place sections, starting with the most constrained
 
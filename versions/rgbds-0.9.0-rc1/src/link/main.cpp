@@ -23,6 +23,7 @@
 #include "link/patch.hpp"
 #include "link/section.hpp"
 #include "link/symbol.hpp"
+#include "link/timing.hpp"
 
 bool isDmgMode;               // -d
 char const *linkerScriptName; // -l
@@ -130,7 +131,7 @@ void argErr(char flag, char const *fmt, ...) {
 }
 
 // Short options
-static char const *optstring = "dl:m:Mn:O:o:p:S:tVvWwx";
+static char const *optstring = "dl:m:Mn:O:o:p:S:T:tVvWwx";
 
 /*
  * Equivalent long options
@@ -152,6 +153,7 @@ static option const longopts[] = {
     {"output",        required_argument, nullptr, 'o'},
     {"pad",           required_argument, nullptr, 'p'},
     {"scramble",      required_argument, nullptr, 'S'},
+    {"time-report",   required_argument, nullptr, 'T'},
     {"tiny",          no_argument,       nullptr, 't'},
     {"version",       no_argument,       nullptr, 'V'},
     {"verbose",       no_argument,       nullptr, 'v'},
@@ -164,7 +166,7 @@ static void printUsage() {
 	fputs(
 	    "Usage: rgblink [-dMtVvwx] [-l script] [-m map_file] [-n sym_file]\n"
 	    "               [-O overlay_file] [-o out_file] [-p pad_value]\n"
-	    "               [-S spec] <file> ...\n"
+	    "               [-S spec] [-T report_file] <file> ...\n"
 	    "Useful options:\n"
 	    "    -l, --linkerscript <path>  set the input linker script\n"
 	    "    -m, --map <path>           set the output map file\n"
@@ -374,6 +376,9 @@ int main(int argc, char *argv[]) {
 		case 'S':
 			parseScrambleSpec(musl_optarg);
 			break;
+		case 'T':
+			timing_SetFileName(musl_optarg);
+			break;
 		case 't':
 			is32kMode = true;
 			break;
@@ -418,13 +423,18 @@ int main(int argc, char *argv[]) {
 	if (isDmgMode)
 		sectionTypeInfo[SECTTYPE_VRAM].lastBank = 0;
 
+	timing_OpenReport();
+
 	// Read all object files first,
-	for (obj_Setup(argc - curArgIndex); curArgIndex < argc; curArgIndex++)
-		obj_ReadFile(argv[curArgIndex], argc - curArgIndex - 1);
+	timing_StartPhase("read_objects");
+	obj_Setup(argc - curArgIndex);
+	obj_ReadFiles(&argv[curArgIndex], argc - curArgIndex);
+	sect_MergeFragmentData();
 
 	// apply the linker script's modifications,
 	if (linkerScriptName) {
 		verbosePrint("Reading linker script...\n");
+		timing_StartPhase("linker_script");
 
 		script_ProcessScript(linkerScriptName);
 
@@ -434,15 +444,24 @@ int main(int argc, char *argv[]) {
 	}
 
 	// then process them,
+	timing_StartPhase("sanity_checks");
 	sect_DoSanityChecks();
 	if (nbErrors != 0)
 		reportErrors();
+	timing_StartPhase("resolve_symbols");
+	patch_ResolveSymbols();
+	timing_StartPhase("assign_sections");
 	assign_AssignSections();
+	timing_StartPhase("check_assertions");
 	patch_CheckAssertions();
 
 	// and finally output the result.
+	timing_StartPhase("apply_patches");
 	patch_ApplyPatches();
 	if (nbErrors != 0)
 		reportErrors();
+	timing_StartPhase("write_files");
 	out_WriteFiles();
+
+	timing_WriteReport(argc - curArgIndex);
 }
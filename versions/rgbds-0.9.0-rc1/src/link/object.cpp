@@ -1,12 +1,14 @@
 /* SPDX-License-Identifier: MIT */
 
 #include "link/object.hpp"
+#include <sys/stat.h>
 
 #include <deque>
 #include <errno.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <memory>
+#include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,6 +18,7 @@
 #include "error.hpp"
 #include "helpers.hpp"
 #include "linkdefs.hpp"
+#include "parallel.hpp"
 #include "platform.hpp"
 #include "version.hpp"
 
@@ -25,20 +28,145 @@
 #include "link/section.hpp"
 #include "link/symbol.hpp"
 
-static std::deque<std::vector<Symbol>> symbolLists;
+// Neither MSVC nor MinGW provide `mmap`
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+	#include <sys/mman.h>
+#endif
+
+static std::vector<std::vector<Symbol>> symbolLists;
 static std::vector<std::vector<FileStackNode>> nodes;
 
+// Object files are decoded in parallel, but merged in command-line order, so that diagnostics
+// are the same as if they had been read one after the other. Thus, while decoding, diagnostics
+// are logged, to be printed during the merge.
+enum DiagKind {
+	DIAG_VERBOSE, // `verbosePrint`
+	DIAG_ERROR,   // `error`, which does not abort reading the file
+	DIAG_ERRX,    // `errx`
+	DIAG_FATAL,   // `fatal`
+};
+
+struct Diagnostic {
+	DiagKind kind;
+	std::string message;
+};
+
+// Everything decoded from a single object file, before it gets merged with the others
+struct LoadedObject {
+	char const *fileName;
+	// SDCC objects are read during the merge instead, reopening them so that they don't all
+	// stay open until then; only standard input cannot be reopened, and so is kept
+	bool isSdas = false;
+	FILE *sdasStdin = nullptr;
+	std::vector<Diagnostic> diags;
+	size_t nbDiagsBeforeSymbols = 0;
+	uint32_t nbSymbolsRead = 0;
+	uint32_t nbSections = 0;
+	std::vector<uint32_t> nbSymPerSect;
+	std::vector<std::unique_ptr<Section>> sections;
+	std::vector<Assertion> assertions;
+};
+
+static thread_local LoadedObject *curObject; // The object being decoded by this thread
+
+[[gnu::format(printf, 2, 3)]] static void logDiag(DiagKind kind, char const *fmt, ...) {
+	if (kind == DIAG_VERBOSE && !beVerbose)
+		return;
+
+	va_list args, argsCopy;
+	va_start(args, fmt);
+	va_copy(argsCopy, args);
+	std::string message(vsnprintf(nullptr, 0, fmt, args), '\0');
+	vsnprintf(message.data(), message.length() + 1, fmt, argsCopy);
+	va_end(argsCopy);
+	va_end(args);
+
+	curObject->diags.push_back({.kind = kind, .message = std::move(message)});
+}
+
+static void printDiags(std::vector<Diagnostic> const &diags, size_t begin, size_t end) {
+	for (size_t i = begin; i < end; i++) {
+		Diagnostic const &diag = diags[i];
+
+		switch (diag.kind) {
+		case DIAG_VERBOSE:
+			verbosePrint("%s", diag.message.c_str());
+			break;
+		case DIAG_ERROR:
+			error(nullptr, 0, "%s", diag.message.c_str());
+			break;
+		case DIAG_ERRX:
+			errx("%s", diag.message.c_str());
+		case DIAG_FATAL:
+			fatal(nullptr, 0, "%s", diag.message.c_str());
+		}
+	}
+}
+
 // Helper functions for reading object files
 
+// An object file's contents, mapped in memory if possible, and otherwise read into a buffer
+class ObjectContents {
+	void *mapping = nullptr; // As returned by `mmap`, to be given back to `munmap`
+	size_t mappingSize;
+	std::vector<uint8_t> buffer;
+
+public:
+	ObjectContents() = default;
+	ObjectContents(ObjectContents const &) = delete;
+	~ObjectContents() {
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+		if (mapping)
+			munmap(mapping, mappingSize);
+#endif
+	}
+
+	/*
+	 * Loads a file's contents, starting from its current position.
+	 * @param file The file to load
+	 * @param canMap Whether the file may be mapped, which reads it from the start instead
+	 * @return Whether the contents could be loaded; if not, `errno` has been set
+	 */
+	bool load(FILE *file, bool canMap) {
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+		if (struct stat statBuf; canMap && fstat(fileno(file), &statBuf) == 0
+		                         && S_ISREG(statBuf.st_mode) && statBuf.st_size > 0) {
+			void *mappingAddr =
+			    mmap(nullptr, statBuf.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+			if (mappingAddr != MAP_FAILED) {
+				mapping = mappingAddr;
+				mappingSize = statBuf.st_size;
+				return true;
+			}
+		}
+#endif
+		// Sometimes mmap() fails or isn't available, so have a fallback
+		uint8_t buf[BUFSIZ];
+		for (size_t nbRead; (nbRead = fread(buf, 1, sizeof(buf), file)) != 0;)
+			buffer.insert(buffer.end(), buf, buf + nbRead);
+		return !ferror(file);
+	}
+
+	uint8_t const *begin() const { return mapping ? (uint8_t const *)mapping : buffer.data(); }
+	uint8_t const *end() const { return begin() + (mapping ? mappingSize : buffer.size()); }
+};
+
+// A bounds-checked cursor over an object file's contents
+struct ObjectReader {
+	uint8_t const *ptr;
+	uint8_t const *end;
+};
+
 // Internal, DO NOT USE.
 // For helper wrapper macros defined below, such as `tryReadLong`
+// On failure, these log an error and make the enclosing function return `false`.
 #define tryRead(func, type, errval, vartype, var, file, ...) \
 	do { \
-		FILE *tmpFile = file; \
-		type tmpVal = func(tmpFile); \
+		type tmpVal = func(file); \
 		/* TODO: maybe mark the condition as `unlikely`; how to do that portably? */ \
 		if (tmpVal == (errval)) { \
-			errx(__VA_ARGS__, feof(tmpFile) ? "Unexpected end of file" : strerror(errno)); \
+			logDiag(DIAG_ERRX, __VA_ARGS__, "Unexpected end of file"); \
+			return false; \
 		} \
 		var = (vartype)tmpVal; \
 	} while (0)
@@ -46,28 +174,43 @@ static std::vector<std::vector<FileStackNode>> nodes;
 /*
  * Reads an unsigned long (32-bit) value from a file.
  * @param file The file to read from. This will read 4 bytes from the file.
- * @return The value read, cast to a int64_t, or -1 on failure.
+ * @return The value read, cast to a int64_t, or INT64_MAX on failure.
  */
-static int64_t readLong(FILE *file) {
-	uint32_t value = 0;
-
-	// Read the little-endian value byte by byte
-	for (uint8_t shift = 0; shift < sizeof(value) * CHAR_BIT; shift += 8) {
-		int byte = getc(file);
-
-		if (byte == EOF)
-			return INT64_MAX;
-		// This must be casted to `unsigned`, not `uint8_t`. Rationale:
-		// the type of the shift is the type of `byte` after undergoing
-		// integer promotion, which would be `int` if this was casted to
-		// `uint8_t`, because int is large enough to hold a byte. This
-		// however causes values larger than 127 to be too large when
-		// shifted, potentially triggering undefined behavior.
-		value |= (unsigned int)byte << shift;
-	}
+static int64_t readLong(ObjectReader &file) {
+	if (file.end - file.ptr < 4)
+		return INT64_MAX;
+
+	// Read the little-endian value; the last byte must be widened to avoid overflowing `int`
+	uint32_t value =
+	    file.ptr[0] | file.ptr[1] << 8 | file.ptr[2] << 16 | (uint32_t)file.ptr[3] << 24;
+	file.ptr += 4;
 	return value;
 }
 
+/*
+ * Reads a byte from a file.
+ * @param file The file to read from. This will read 1 byte from the file.
+ * @return The byte read, or EOF on failure.
+ */
+static int readByte(ObjectReader &file) {
+	return file.ptr != file.end ? *file.ptr++ : EOF;
+}
+
+/*
+ * Copies bytes from a file.
+ * @param file The file to read from. This will read `size` bytes from the file.
+ * @param dest The buffer to store the bytes into
+ * @param size How many bytes to read
+ * @return Whether there were enough bytes to read
+ */
+static bool readBytes(ObjectReader &file, std::vector<uint8_t> &dest, size_t size) {
+	if ((size_t)(file.end - file.ptr) < size)
+		return false;
+	dest.assign(file.ptr, file.ptr + size);
+	file.ptr += size;
+	return true;
+}
+
 /*
  * Helper macro for reading longs from a file, and errors out if it fails to.
  * Not as a function to avoid overhead in the general case.
@@ -79,8 +222,6 @@ static int64_t readLong(FILE *file) {
 #define tryReadLong(var, file, ...) \
 	tryRead(readLong, int64_t, INT64_MAX, long, var, file, __VA_ARGS__)
 
-// There is no `readbyte`, just use `fgetc` or `getc`.
-
 /*
  * Helper macro for reading bytes from a file, and errors out if it fails to.
  * Not as a function to avoid overhead in the general case.
@@ -89,7 +230,7 @@ static int64_t readLong(FILE *file) {
  * @param ... A format string and related arguments; note that an extra string
  *            argument is provided, the reason for failure
  */
-#define tryGetc(type, var, file, ...) tryRead(getc, int, EOF, type, var, file, __VA_ARGS__)
+#define tryGetc(type, var, file, ...) tryRead(readByte, int, EOF, type, var, file, __VA_ARGS__)
 
 /*
  * Helper macro for readings '\0'-terminated strings from a file, and errors out if it fails to.
@@ -101,15 +242,15 @@ static int64_t readLong(FILE *file) {
  */
 #define tryReadString(var, file, ...) \
 	do { \
-		FILE *tmpFile = file; \
-		std::string &tmpVal = var; \
-		for (int tmpByte = getc(tmpFile); tmpByte != '\0'; tmpByte = getc(tmpFile)) { \
-			if (tmpByte == EOF) { \
-				errx(__VA_ARGS__, feof(tmpFile) ? "Unexpected end of file" : strerror(errno)); \
-			} else { \
-				tmpVal.push_back(tmpByte); \
-			} \
-		}; \
+		ObjectReader &tmpFile = file; \
+		uint8_t const *tmpEnd = \
+		    (uint8_t const *)memchr(tmpFile.ptr, '\0', tmpFile.end - tmpFile.ptr); \
+		if (!tmpEnd) { \
+			logDiag(DIAG_ERRX, __VA_ARGS__, "Unexpected end of file"); \
+			return false; \
+		} \
+		var.assign((char const *)tmpFile.ptr, (char const *)tmpEnd); \
+		tmpFile.ptr = tmpEnd + 1; \
 	} while (0)
 
 // Functions to parse object files
@@ -120,9 +261,10 @@ static int64_t readLong(FILE *file) {
  * @param nodes The file's array of nodes
  * @param i The ID of the node in the array
  * @param fileName The filename to report in errors
+ * @return Whether the node could be read
  */
-static void readFileStackNode(
-    FILE *file, std::vector<FileStackNode> &fileNodes, uint32_t i, char const *fileName
+static bool readFileStackNode(
+    ObjectReader &file, std::vector<FileStackNode> &fileNodes, uint32_t i, char const *fileName
 ) {
 	FileStackNode &node = fileNodes[i];
 	uint32_t parentID;
@@ -162,15 +304,17 @@ static void readFileStackNode(
 			    i,
 			    k
 			);
-		if (!node.parent)
-			fatal(
-			    nullptr,
-			    0,
+		if (!node.parent) {
+			logDiag(
+			    DIAG_FATAL,
 			    "%s is not a valid object file: root node (#%" PRIu32 ") may not be REPT",
 			    fileName,
 			    i
 			);
+			return false;
+		}
 	}
+	return true;
 }
 
 /*
@@ -178,9 +322,13 @@ static void readFileStackNode(
  * @param file The file to read from
  * @param symbol The symbol to fill
  * @param fileName The filename to report in errors
+ * @return Whether the symbol could be read
  */
-static void readSymbol(
-    FILE *file, Symbol &symbol, char const *fileName, std::vector<FileStackNode> const &fileNodes
+static bool readSymbol(
+    ObjectReader &file,
+    Symbol &symbol,
+    char const *fileName,
+    std::vector<FileStackNode> const &fileNodes
 ) {
 	tryReadString(symbol.name, file, "%s: Cannot read symbol name: %s", fileName);
 	tryGetc(
@@ -229,6 +377,7 @@ static void readSymbol(
 	} else {
 		symbol.data = -1;
 	}
+	return true;
 }
 
 /*
@@ -237,9 +386,10 @@ static void readSymbol(
  * @param patch The patch to fill
  * @param fileName The filename to report in errors
  * @param i The number of the patch to report in errors
+ * @return Whether the patch could be read
  */
-static void readPatch(
-    FILE *file,
+static bool readPatch(
+    ObjectReader &file,
     Patch &patch,
     char const *fileName,
     std::string const &sectName,
@@ -309,17 +459,18 @@ static void readPatch(
 	    i
 	);
 
-	patch.rpnExpression.resize(rpnSize);
-	size_t nbElementsRead = fread(patch.rpnExpression.data(), 1, rpnSize, file);
-
-	if (nbElementsRead != rpnSize)
-		errx(
+	if (!readBytes(file, patch.rpnExpression, rpnSize)) {
+		logDiag(
+		    DIAG_ERRX,
 		    "%s: Cannot read \"%s\"'s patch #%" PRIu32 "'s RPN expression: %s",
 		    fileName,
 		    sectName.c_str(),
 		    i,
-		    feof(file) ? "Unexpected end of file" : strerror(errno)
+		    "Unexpected end of file"
 		);
+		return false;
+	}
+	return true;
 }
 
 /*
@@ -337,9 +488,13 @@ static void
  * @param file The file to read from
  * @param section The section to fill
  * @param fileName The filename to report in errors
+ * @return Whether the section could be read
  */
-static void readSection(
-    FILE *file, Section &section, char const *fileName, std::vector<FileStackNode> const &fileNodes
+static bool readSection(
+    ObjectReader &file,
+    Section &section,
+    char const *fileName,
+    std::vector<FileStackNode> const &fileNodes
 ) {
 	int32_t tmp;
 	uint8_t byte;
@@ -358,15 +513,22 @@ static void readSection(
 	    section.name.c_str()
 	);
 	tryReadLong(tmp, file, "%s: Cannot read \"%s\"'s' size: %s", fileName, section.name.c_str());
-	if (tmp < 0 || tmp > UINT16_MAX)
-		errx("\"%s\"'s section size (%" PRId32 ") is invalid", section.name.c_str(), tmp);
+	if (tmp < 0 || tmp > UINT16_MAX) {
+		logDiag(
+		    DIAG_ERRX, "\"%s\"'s section size (%" PRId32 ") is invalid", section.name.c_str(), tmp
+		);
+		return false;
+	}
 	section.size = tmp;
 	section.offset = 0;
 	tryGetc(
 	    uint8_t, byte, file, "%s: Cannot read \"%s\"'s type: %s", fileName, section.name.c_str()
 	);
 	if (uint8_t type = byte & 0x3F; type >= SECTTYPE_INVALID) {
-		errx("\"%s\" has unknown section type 0x%02x", section.name.c_str(), type);
+		logDiag(
+		    DIAG_ERRX, "\"%s\" has unknown section type 0x%02x", section.name.c_str(), type
+		);
+		return false;
 	} else {
 		section.type = SectionType(type);
 	}
@@ -379,7 +541,7 @@ static void readSection(
 	tryReadLong(tmp, file, "%s: Cannot read \"%s\"'s org: %s", fileName, section.name.c_str());
 	section.isAddressFixed = tmp >= 0;
 	if (tmp > UINT16_MAX) {
-		error(nullptr, 0, "\"%s\"'s org is too large (%" PRId32 ")", section.name.c_str(), tmp);
+		logDiag(DIAG_ERROR, "\"%s\"'s org is too large (%" PRId32 ")", section.name.c_str(), tmp);
 		tmp = UINT16_MAX;
 	}
 	section.org = tmp;
@@ -402,9 +564,8 @@ static void readSection(
 	    tmp, file, "%s: Cannot read \"%s\"'s alignment offset: %s", fileName, section.name.c_str()
 	);
 	if (tmp > UINT16_MAX) {
-		error(
-		    nullptr,
-		    0,
+		logDiag(
+		    DIAG_ERROR,
 		    "\"%s\"'s alignment offset is too large (%" PRId32 ")",
 		    section.name.c_str(),
 		    tmp
@@ -414,16 +575,15 @@ static void readSection(
 	section.alignOfs = tmp;
 
 	if (sect_HasData(section.type)) {
-		if (section.size) {
-			section.data.resize(section.size);
-			if (size_t nbRead = fread(section.data.data(), 1, section.size, file);
-			    nbRead != section.size)
-				errx(
-				    "%s: Cannot read \"%s\"'s data: %s",
-				    fileName,
-				    section.name.c_str(),
-				    feof(file) ? "Unexpected end of file" : strerror(errno)
-				);
+		if (section.size && !readBytes(file, section.data, section.size)) {
+			logDiag(
+			    DIAG_ERRX,
+			    "%s: Cannot read \"%s\"'s data: %s",
+			    fileName,
+			    section.name.c_str(),
+			    "Unexpected end of file"
+			);
+			return false;
 		}
 
 		uint32_t nbPatches;
@@ -437,9 +597,12 @@ static void readSection(
 		);
 
 		section.patches.resize(nbPatches);
-		for (uint32_t i = 0; i < nbPatches; i++)
-			readPatch(file, section.patches[i], fileName, section.name, i, fileNodes);
+		for (uint32_t i = 0; i < nbPatches; i++) {
+			if (!readPatch(file, section.patches[i], fileName, section.name, i, fileNodes))
+				return false;
+		}
 	}
+	return true;
 }
 
 /*
@@ -469,9 +632,10 @@ static void linkSymToSect(Symbol &symbol, Section &section) {
  * @param file The file to read from
  * @param assert The assertion to fill
  * @param fileName The filename to report in errors
+ * @return Whether the assertion could be read
  */
-static void readAssertion(
-    FILE *file,
+static bool readAssertion(
+    ObjectReader &file,
     Assertion &assert,
     char const *fileName,
     uint32_t i,
@@ -480,21 +644,33 @@ static void readAssertion(
 	std::string assertName("Assertion #");
 
 	assertName += std::to_string(i);
-	readPatch(file, assert.patch, fileName, assertName, 0, fileNodes);
+	if (!readPatch(file, assert.patch, fileName, assertName, 0, fileNodes))
+		return false;
 	tryReadString(assert.message, file, "%s: Cannot read assertion's message: %s", fileName);
+	return true;
 }
 
-void obj_ReadFile(char const *fileName, unsigned int fileID) {
-	FILE *file;
+/*
+ * Decodes an object file, without affecting any global state other than the file's own lists.
+ * @param object Where to store the object's contents
+ * @param fileID The ID of the file
+ * @return Whether the file could be read; if not, an error has been logged
+ */
+static bool decodeFile(LoadedObject &object, unsigned int fileID) {
+	char const *fileName = object.fileName;
+	FILE *file, *stdinFile = nullptr;
 	if (strcmp(fileName, "-")) {
 		file = fopen(fileName, "rb");
 	} else {
 		fileName = "<stdin>";
+		object.fileName = fileName;
 		file = fdopen(STDIN_FILENO, "rb"); // `stdin` is in text mode by default
+		stdinFile = file;
+	}
+	if (!file) {
+		logDiag(DIAG_ERRX, "Failed to open file \"%s\": %s", fileName, strerror(errno));
+		return false;
 	}
-	if (!file)
-		err("Failed to open file \"%s\"", fileName);
-	Defer closeFile{[&] { fclose(file); }};
 
 	// First, check if the object is a RGBDS object or a SDCC one. If the first byte is 'R',
 	// we'll assume it's a RGBDS object file, and otherwise, that it's a SDCC object file.
@@ -503,42 +679,50 @@ void obj_ReadFile(char const *fileName, unsigned int fileID) {
 	ungetc(c, file); // Guaranteed to work
 	switch (c) {
 	case EOF:
-		fatal(nullptr, 0, "File \"%s\" is empty!", fileName);
+		fclose(file);
+		logDiag(DIAG_FATAL, "File \"%s\" is empty!", fileName);
+		return false;
 
 	case 'R':
 		break;
 
 	default:
-		// This is (probably) a SDCC object file, defer the rest of detection to it.
-		// Since SDCC does not provide line info, everything will be reported as coming from the
-		// object file. It's better than nothing.
-		nodes[fileID].push_back({
-		    .type = NODE_FILE,
-		    .data = Either<std::vector<uint32_t>, std::string>(fileName),
-		    .parent = nullptr,
-		    .lineNo = 0,
-		});
-
-		std::vector<Symbol> &fileSymbols = symbolLists.emplace_front();
+		// This is (probably) a SDCC object file, defer the rest of detection to the merge.
+		object.isSdas = true;
+		if (file == stdinFile)
+			object.sdasStdin = file;
+		else
+			fclose(file);
+		return true;
+	}
+	Defer closeFile{[&] { fclose(file); }};
 
-		sdobj_ReadFile(nodes[fileID].back(), file, fileSymbols);
-		return;
+	// The contents are parsed in place, so only section data and RPN buffers get copied
+	ObjectContents contents;
+	if (!contents.load(file, !stdinFile)) {
+		logDiag(DIAG_ERRX, "Failed to read file \"%s\": %s", fileName, strerror(errno));
+		return false;
 	}
+	ObjectReader reader{.ptr = contents.begin(), .end = contents.end()};
 
 	// Begin by reading the magic bytes
-	int matchedElems;
+	size_t magicLen = QUOTEDSTRLEN(RGBDS_OBJECT_VERSION_STRING);
 
-	if (fscanf(file, RGBDS_OBJECT_VERSION_STRING "%n", &matchedElems) == 1
-	    && matchedElems != strlen(RGBDS_OBJECT_VERSION_STRING))
-		errx("%s: Not a RGBDS object file", fileName);
+	if ((size_t)(reader.end - reader.ptr) < magicLen
+	    || memcmp(reader.ptr, RGBDS_OBJECT_VERSION_STRING, magicLen)) {
+		logDiag(DIAG_ERRX, "%s: Not a RGBDS object file", fileName);
+		return false;
+	}
+	reader.ptr += magicLen;
 
-	verbosePrint("Reading object file %s\n", fileName);
+	logDiag(DIAG_VERBOSE, "Reading object file %s\n", fileName);
 
 	uint32_t revNum;
 
-	tryReadLong(revNum, file, "%s: Cannot read revision number: %s", fileName);
-	if (revNum != RGBDS_OBJECT_REV)
-		errx(
+	tryReadLong(revNum, reader, "%s: Cannot read revision number: %s", fileName);
+	if (revNum != RGBDS_OBJECT_REV) {
+		logDiag(
+		    DIAG_ERRX,
 		    "%s: Unsupported object file for rgblink %s; try rebuilding \"%s\"%s"
 		    " (expected revision %d, got %d)",
 		    fileName,
@@ -548,59 +732,71 @@ void obj_ReadFile(char const *fileName, unsigned int fileID) {
 		    RGBDS_OBJECT_REV,
 		    revNum
 		);
+		return false;
+	}
 
 	uint32_t nbNodes;
 	uint32_t nbSymbols;
 	uint32_t nbSections;
 
-	tryReadLong(nbSymbols, file, "%s: Cannot read number of symbols: %s", fileName);
-	tryReadLong(nbSections, file, "%s: Cannot read number of sections: %s", fileName);
+	tryReadLong(nbSymbols, reader, "%s: Cannot read number of symbols: %s", fileName);
+	tryReadLong(nbSections, reader, "%s: Cannot read number of sections: %s", fileName);
 
-	nbSectionsToAssign += nbSections;
+	object.nbSections = nbSections;
 
-	tryReadLong(nbNodes, file, "%s: Cannot read number of nodes: %s", fileName);
+	tryReadLong(nbNodes, reader, "%s: Cannot read number of nodes: %s", fileName);
 	nodes[fileID].resize(nbNodes);
-	verbosePrint("Reading %u nodes...\n", nbNodes);
-	for (uint32_t i = nbNodes; i--;)
-		readFileStackNode(file, nodes[fileID], i, fileName);
+	logDiag(DIAG_VERBOSE, "Reading %u nodes...\n", nbNodes);
+	for (uint32_t i = nbNodes; i--;) {
+		if (!readFileStackNode(reader, nodes[fileID], i, fileName))
+			return false;
+	}
 
 	// This file's symbols, kept to link sections to them
-	std::vector<Symbol> &fileSymbols = symbolLists.emplace_front(nbSymbols);
-	std::vector<uint32_t> nbSymPerSect(nbSections, 0);
+	std::vector<Symbol> &fileSymbols = symbolLists[fileID];
+	fileSymbols.resize(nbSymbols);
+	object.nbSymPerSect.resize(nbSections, 0);
 
-	verbosePrint("Reading %" PRIu32 " symbols...\n", nbSymbols);
+	logDiag(DIAG_VERBOSE, "Reading %" PRIu32 " symbols...\n", nbSymbols);
+	// Symbols are added as they are read, so diagnostics in-between must be printed in order
+	object.nbDiagsBeforeSymbols = object.diags.size();
 	for (uint32_t i = 0; i < nbSymbols; i++) {
 		// Read symbol
 		Symbol &symbol = fileSymbols[i];
 
-		readSymbol(file, symbol, fileName, nodes[fileID]);
+		if (!readSymbol(reader, symbol, fileName, nodes[fileID]))
+			return false;
+		object.nbSymbolsRead++;
 
-		sym_AddSymbol(symbol);
 		if (symbol.data.holds<Label>())
-			nbSymPerSect[symbol.data.get<Label>().sectionID]++;
+			object.nbSymPerSect[symbol.data.get<Label>().sectionID]++;
 	}
 
 	// This file's sections, stored in a table to link symbols to them
-	std::vector<std::unique_ptr<Section>> fileSections(nbSections);
+	std::vector<std::unique_ptr<Section>> &fileSections = object.sections;
+	fileSections.resize(nbSections);
 
-	verbosePrint("Reading %" PRIu32 " sections...\n", nbSections);
+	logDiag(DIAG_VERBOSE, "Reading %" PRIu32 " sections...\n", nbSections);
 	for (uint32_t i = 0; i < nbSections; i++) {
 		// Read section
 		fileSections[i] = std::make_unique<Section>();
 		fileSections[i]->nextu = nullptr;
-		readSection(file, *fileSections[i], fileName, nodes[fileID]);
+		if (!readSection(reader, *fileSections[i], fileName, nodes[fileID]))
+			return false;
 		fileSections[i]->fileSymbols = &fileSymbols;
-		fileSections[i]->symbols.reserve(nbSymPerSect[i]);
+		fileSections[i]->symbols.reserve(object.nbSymPerSect[i]);
 	}
 
 	uint32_t nbAsserts;
 
-	tryReadLong(nbAsserts, file, "%s: Cannot read number of assertions: %s", fileName);
-	verbosePrint("Reading %" PRIu32 " assertions...\n", nbAsserts);
+	tryReadLong(nbAsserts, reader, "%s: Cannot read number of assertions: %s", fileName);
+	logDiag(DIAG_VERBOSE, "Reading %" PRIu32 " assertions...\n", nbAsserts);
+	object.assertions.resize(nbAsserts);
 	for (uint32_t i = 0; i < nbAsserts; i++) {
-		Assertion &assertion = assertions.emplace_front();
+		Assertion &assertion = object.assertions[i];
 
-		readAssertion(file, assertion, fileName, i, nodes[fileID]);
+		if (!readAssertion(reader, assertion, fileName, i, nodes[fileID]))
+			return false;
 		linkPatchToPCSect(assertion.patch, fileSections);
 		assertion.fileSymbols = &fileSymbols;
 	}
@@ -623,16 +819,60 @@ void obj_ReadFile(char const *fileName, unsigned int fileID) {
 		}
 	}
 
+	return true;
+}
+
+/*
+ * Adds a decoded object file's contents to the global data structures.
+ * @param object The object's contents
+ * @param fileID The ID of the file
+ */
+static void mergeFile(LoadedObject &object, unsigned int fileID) {
+	std::vector<Diagnostic> const &diags = object.diags;
+
+	if (object.isSdas) {
+		FILE *file = object.sdasStdin ? object.sdasStdin : fopen(object.fileName, "rb");
+		if (!file)
+			errx("Failed to open file \"%s\": %s", object.fileName, strerror(errno));
+		Defer closeFile{[&] { fclose(file); }};
+
+		// Since SDCC does not provide line info, everything will be reported as coming from the
+		// object file. It's better than nothing.
+		nodes[fileID].push_back({
+		    .type = NODE_FILE,
+		    .data = Either<std::vector<uint32_t>, std::string>(object.fileName),
+		    .parent = nullptr,
+		    .lineNo = 0,
+		});
+
+		sdobj_ReadFile(nodes[fileID].back(), file, symbolLists[fileID]);
+		return;
+	}
+
+	printDiags(diags, 0, object.nbDiagsBeforeSymbols);
+
+	std::vector<Symbol> &fileSymbols = symbolLists[fileID];
+	for (uint32_t i = 0; i < object.nbSymbolsRead; i++)
+		sym_AddSymbol(fileSymbols[i]);
+
+	// This exits if the file could not be fully read
+	printDiags(diags, object.nbDiagsBeforeSymbols, diags.size());
+
+	nbSectionsToAssign += object.nbSections;
+
+	for (Assertion &assertion : object.assertions)
+		assertions.push_front(std::move(assertion));
+
 	// Calling `sect_AddSection` invalidates the contents of `fileSections`!
-	for (uint32_t i = 0; i < nbSections; i++)
-		sect_AddSection(std::move(fileSections[i]));
+	for (std::unique_ptr<Section> &section : object.sections)
+		sect_AddSection(std::move(section));
 
 	// Fix symbols' section pointers to component sections
 	// This has to run **after** all the `sect_AddSection()` calls,
 	// so that `sect_GetSection()` will work
-	for (uint32_t i = 0; i < nbSymbols; i++) {
-		if (fileSymbols[i].data.holds<Label>()) {
-			Label &label = fileSymbols[i].data.get<Label>();
+	for (Symbol &symbol : fileSymbols) {
+		if (symbol.data.holds<Label>()) {
+			Label &label = symbol.data.get<Label>();
 			if (Section *section = label.section; section->modifier != SECTION_NORMAL) {
 				if (section->modifier == SECTION_FRAGMENT) {
 					// Add the fragment's offset to the symbol's
@@ -646,6 +886,23 @@ void obj_ReadFile(char const *fileName, unsigned int fileID) {
 	}
 }
 
+void obj_ReadFiles(char const * const *fileNames, unsigned int nbFiles) {
+	std::vector<LoadedObject> objects(nbFiles);
+
+	// Files are given decreasing IDs, in command-line order
+	parallelFor(nbFiles, defaultNbThreads(), [&](size_t i) {
+		objects[i].fileName = fileNames[i];
+		curObject = &objects[i];
+		decodeFile(objects[i], nbFiles - i - 1); // Failures are reported by `mergeFile`
+	});
+
+	for (unsigned int i = 0; i < nbFiles; i++) {
+		mergeFile(objects[i], nbFiles - i - 1);
+		objects[i] = LoadedObject(); // Free up the file's remaining data early
+	}
+}
+
 void obj_Setup(unsigned int nbFiles) {
 	nodes.resize(nbFiles);
+	symbolLists.resize(nbFiles);
 }
@@ -3,17 +3,20 @@
 #include "link/output.hpp"
 
 #include <algorithm>
+#include <charconv>
 #include <deque>
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string>
 #include <vector>
 
 #include "error.hpp"
 #include "extern/utf8decoder.hpp"
 #include "helpers.hpp"
 #include "linkdefs.hpp"
+#include "parallel.hpp"
 #include "platform.hpp"
 
 #include "link/main.hpp"
@@ -30,14 +33,17 @@ FILE *mapFile;
 struct SortedSymbol {
 	Symbol const *sym;
 	uint16_t addr;
+	bool isLocal; // Whether the name contains a '.'
 };
 
+// Sections are appended as they get assigned, and only sorted by address once they are needed
 struct SortedSections {
-	std::deque<Section const *> sections;
-	std::deque<Section const *> zeroLenSections;
+	std::vector<Section const *> sections;
+	std::vector<Section const *> zeroLenSections;
 };
 
 static std::deque<SortedSections> sections[SECTTYPE_INVALID];
+static bool sectionsSorted = true;
 
 // Defines the order in which types are output to the sym and map files
 static SectionType typeMap[SECTTYPE_INVALID] = {
@@ -77,24 +83,50 @@ void out_AddSection(Section const &section) {
 	for (uint32_t i = sections[section.type].size(); i < minNbBanks; i++)
 		sections[section.type].emplace_back();
 
-	std::deque<Section const *> &bankSections =
+	std::vector<Section const *> &bankSections =
 	    section.size ? sections[section.type][targetBank].sections
 	                 : sections[section.type][targetBank].zeroLenSections;
-	auto pos = bankSections.begin();
 
-	while (pos != bankSections.end() && (*pos)->org < section.org)
-		pos++;
+	bankSections.push_back(&section);
+	sectionsSorted = false;
+}
+
+// Sorts a bank's sections by increasing address; among sections at the same address, the ones
+// added last come first
+static void sortBankSections(std::vector<Section const *> &bankSections) {
+	std::reverse(RANGE(bankSections));
+	std::stable_sort(RANGE(bankSections), [](Section const *lhs, Section const *rhs) {
+		return lhs->org < rhs->org;
+	});
+}
 
-	bankSections.insert(pos, &section);
+static void sortSections() {
+	if (sectionsSorted)
+		return;
+
+	for (std::deque<SortedSections> &typeSections : sections) {
+		for (SortedSections &bankSections : typeSections) {
+			sortBankSections(bankSections.sections);
+			sortBankSections(bankSections.zeroLenSections);
+		}
+	}
+	sectionsSorted = true;
 }
 
 Section const *out_OverlappingSection(Section const &section) {
 	uint32_t bank = section.bank - sectionTypeInfo[section.type].firstBank;
 
-	for (Section const *ptr : sections[section.type][bank].sections) {
-		if (ptr->org < section.org + section.size && section.org < ptr->org + ptr->size)
-			return ptr;
-	}
+	sortSections();
+	std::vector<Section const *> const &bankSections = sections[section.type][bank].sections;
+	// Assigned sections do not overlap each other, so they also end in increasing order
+	auto ptr = std::upper_bound(
+	    RANGE(bankSections),
+	    section.org,
+	    [](uint16_t org, Section const *other) { return org < other->org + other->size; }
+	);
+
+	if (ptr != bankSections.end() && (*ptr)->org < section.org + section.size)
+		return *ptr;
 	return nullptr;
 }
 
@@ -146,12 +178,22 @@ static void coverOverlayBanks(uint32_t nbOverlayBanks) {
 	}
 }
 
-static uint8_t getNextFillByte() {
+// The bank being written, which is built in memory so that it can be output all at once
+static std::vector<uint8_t> bankData;
+
+/*
+ * Appends padding to the bank being written, taking it from the overlay file if there is one.
+ * @param len The number of bytes of padding
+ */
+static void padBank(size_t len) {
+	size_t begin = bankData.size();
+
+	bankData.resize(begin + len);
 	if (overlayFile) {
-		int c = getc(overlayFile);
-		if (c != EOF) {
-			return c;
-		}
+		size_t nbRead = fread(bankData.data() + begin, 1, len, overlayFile);
+		if (nbRead == len)
+			return;
+		begin += nbRead;
 
 		if (static bool warned = false; !hasPadValue && !warned) {
 			warnx("Output is larger than overlay file, but no padding value was specified");
@@ -159,7 +201,7 @@ static uint8_t getNextFillByte() {
 		}
 	}
 
-	return padValue;
+	memset(bankData.data() + begin, padValue, bankData.size() - begin);
 }
 
 /*
@@ -169,35 +211,31 @@ static uint8_t getNextFillByte() {
  * @param size The size of the bank
  */
 static void
-    writeBank(std::deque<Section const *> *bankSections, uint16_t baseOffset, uint16_t size) {
-	uint16_t offset = 0;
+    writeBank(std::vector<Section const *> *bankSections, uint16_t baseOffset, uint16_t size) {
+	bankData.clear();
 
 	if (bankSections) {
 		for (Section const *section : *bankSections) {
 			assume(section->offset == 0);
 			// Output padding up to the next SECTION
-			while (offset + baseOffset < section->org) {
-				putc(getNextFillByte(), outputFile);
-				offset++;
-			}
+			if (bankData.size() + baseOffset < section->org)
+				padBank(section->org - baseOffset - bankData.size());
 
 			// Output the section itself
-			fwrite(section->data.data(), 1, section->size, outputFile);
-			if (overlayFile) {
-				// Skip bytes even with pipes
-				for (uint16_t i = 0; i < section->size; i++)
-					getc(overlayFile);
-			}
-			offset += section->size;
-		}
-	}
+			size_t begin = bankData.size();
 
-	if (!disablePadding) {
-		while (offset < size) {
-			putc(getNextFillByte(), outputFile);
-			offset++;
+			bankData.resize(begin + section->size);
+			// Skip bytes even with pipes, by reading them where the section will be copied
+			if (overlayFile)
+				fread(bankData.data() + begin, 1, section->size, overlayFile);
+			memcpy(bankData.data() + begin, section->data.data(), section->size);
 		}
 	}
+
+	if (!disablePadding && bankData.size() < size)
+		padBank(size - bankData.size());
+
+	fwrite(bankData.data(), 1, bankData.size(), outputFile);
 }
 
 // Writes a ROM file to the output.
@@ -264,17 +302,49 @@ static bool isLegalForSymName(char c) {
 	       || c == '@' || c == '#' || c == '$' || c == '.';
 }
 
-// Prints a symbol's name to `symFile`, assuming that the first character is legal.
+// The sym and map files are built one bank at a time in memory, so that banks can be formatted
+// in parallel and then written in order. These append what `printf` would print for a format.
+
+// Equivalent to `%0*x`
+static void appendHex(std::string &out, uint32_t value, unsigned minWidth) {
+	static char const digits[] = "0123456789abcdef";
+	char buf[8];
+	unsigned len = 0;
+
+	do {
+		buf[sizeof(buf) - ++len] = digits[value & 0xF];
+		value >>= 4;
+	} while (value != 0);
+	if (len < minWidth)
+		out.append(minWidth - len, '0');
+	out.append(&buf[sizeof(buf) - len], len);
+}
+
+// Equivalent to `%u`
+static void appendDecimal(std::string &out, uint32_t value) {
+	char buf[10];
+	auto result = std::to_chars(buf, buf + sizeof(buf), value);
+
+	out.append(buf, result.ptr);
+}
+
+// Equivalent to `byte%s` with `len == 1 ? "" : "s"`
+static void appendBytes(std::string &out, uint32_t len) {
+	out.append(len == 1 ? "byte" : "bytes");
+}
+
+// Prints a symbol's name to `out`, assuming that the first character is legal.
 // Illegal characters are UTF-8-decoded (errors are replaced by U+FFFD) and emitted as `\u`/`\U`.
-static void printSymName(char const *name) {
-	for (char const *ptr = name; *ptr != '\0';) {
-		char c = *ptr;
-
-		if (isLegalForSymName(c)) {
-			// Output legal ASCII characters as-is
-			putc(c, symFile);
-			++ptr;
-		} else {
+static void printSymName(std::string &out, std::string const &name) {
+	for (char const *ptr = name.c_str(); *ptr != '\0';) {
+		// Output legal ASCII characters as-is
+		char const *legalEnd = ptr;
+		while (isLegalForSymName(*legalEnd))
+			++legalEnd;
+		out.append(ptr, legalEnd);
+		ptr = legalEnd;
+
+		if (*ptr != '\0') {
 			// Output illegal characters using Unicode escapes
 			// Decode the UTF-8 codepoint; or at least attempt to
 			uint32_t state = 0, codepoint;
@@ -293,7 +363,8 @@ static void printSymName(char const *name) {
 				++ptr;
 			} while (state != 0);
 
-			fprintf(symFile, codepoint <= 0xFFFF ? "\\u%04" PRIx32 : "\\U%08" PRIx32, codepoint);
+			out.append(codepoint <= 0xFFFF ? "\\u" : "\\U");
+			appendHex(out, codepoint, codepoint <= 0xFFFF ? 4 : 8);
 		}
 	}
 }
@@ -304,12 +375,12 @@ static bool compareSymbols(SortedSymbol const &sym1, SortedSymbol const &sym2) {
 	if (sym1.addr != sym2.addr)
 		return sym1.addr < sym2.addr;
 
-	std::string const &sym1_name = sym1.sym->name;
-	std::string const &sym2_name = sym2.sym->name;
-	bool sym1_local = sym1_name.find(".") != std::string::npos;
-	bool sym2_local = sym2_name.find(".") != std::string::npos;
+	bool sym1_local = sym1.isLocal;
+	bool sym2_local = sym2.isLocal;
 
 	if (sym1_local != sym2_local) {
+		std::string const &sym1_name = sym1.sym->name;
+		std::string const &sym2_name = sym2.sym->name;
 		size_t sym1_len = sym1_name.length();
 		size_t sym2_len = sym2_name.length();
 
@@ -327,9 +398,12 @@ static bool compareSymbols(SortedSymbol const &sym1, SortedSymbol const &sym2) {
 
 /*
  * Write a bank's contents to the sym file
+ * @param out The bank's text in the sym file
  * @param bankSections The bank's sections
  */
-static void writeSymBank(SortedSections const &bankSections, SectionType type, uint32_t bank) {
+static void writeSymBank(
+    std::string &out, SortedSections const &bankSections, SectionType type, uint32_t bank
+) {
 #define forEachSortedSection(sect, ...) \
 	do { \
 		for (auto it = bankSections.zeroLenSections.begin(); \
@@ -352,17 +426,21 @@ static void writeSymBank(SortedSections const &bankSections, SectionType type, u
 		return;
 
 	std::vector<SortedSymbol> symList;
+	size_t namesLen = 0;
 
 	symList.reserve(nbSymbols);
 
 	forEachSortedSection(sect, {
 		for (Symbol const *sym : sect->symbols) {
 			// Don't output symbols that begin with an illegal character
-			if (!sym->name.empty() && canStartSymName(sym->name[0]))
+			if (!sym->name.empty() && canStartSymName(sym->name[0])) {
 				symList.push_back({
 				    .sym = sym,
 				    .addr = (uint16_t)(sym->label().offset + sect->org),
+				    .isLocal = sym->name.find('.') != std::string::npos,
 				});
+				namesLen += sym->name.length();
+			}
 		}
 	});
 
@@ -372,38 +450,49 @@ static void writeSymBank(SortedSections const &bankSections, SectionType type, u
 
 	uint32_t symBank = bank + sectionTypeInfo[type].firstBank;
 
+	// Names rarely need escaping, and "bb:aaaa \n" is 9 bytes long
+	out.reserve(namesLen + symList.size() * 9);
 	for (SortedSymbol &sym : symList) {
-		fprintf(symFile, "%02" PRIx32 ":%04" PRIx16 " ", symBank, sym.addr);
-		printSymName(sym.sym->name.c_str());
-		putc('\n', symFile);
+		// "%02x:%04x "
+		appendHex(out, symBank, 2);
+		out.push_back(':');
+		appendHex(out, sym.addr, 4);
+		out.push_back(' ');
+		printSymName(out, sym.sym->name);
+		out.push_back('\n');
 	}
 }
 
-static void writeEmptySpace(uint16_t begin, uint16_t end) {
+static void writeEmptySpace(std::string &out, uint16_t begin, uint16_t end) {
 	if (begin < end) {
 		uint16_t len = end - begin;
 
-		fprintf(
-		    mapFile,
-		    "\tEMPTY: $%04x-$%04x ($%04" PRIx16 " byte%s)\n",
-		    begin,
-		    end - 1,
-		    len,
-		    len == 1 ? "" : "s"
-		);
+		// "\tEMPTY: $%04x-$%04x ($%04x byte%s)\n"
+		out.append("\tEMPTY: $");
+		appendHex(out, begin, 4);
+		out.append("-$");
+		appendHex(out, end - 1, 4);
+		out.append(" ($");
+		appendHex(out, len, 4);
+		out.push_back(' ');
+		appendBytes(out, len);
+		out.append(")\n");
 	}
 }
 
 /*
  * Write a bank's contents to the map file
+ * @param out The bank's text in the map file
  */
-static void writeMapBank(SortedSections const &sectList, SectionType type, uint32_t bank) {
-	fprintf(
-	    mapFile,
-	    "\n%s bank #%" PRIu32 ":\n",
-	    sectionTypeInfo[type].name.c_str(),
-	    bank + sectionTypeInfo[type].firstBank
-	);
+static void writeMapBank(
+    std::string &out, SortedSections const &sectList, SectionType type, uint32_t bank
+) {
+	// "\n%s bank #%u:\n"
+	out.push_back('\n');
+	out.append(sectionTypeInfo[type].name);
+	out.append(" bank #");
+	appendDecimal(out, bank + sectionTypeInfo[type].firstBank);
+	out.append(":\n");
 
 	uint16_t used = 0;
 	auto section = sectList.sections.begin();
@@ -421,46 +510,46 @@ static void writeMapBank(SortedSections const &sectList, SectionType type, uint3
 		used += sect->size;
 		assume(sect->offset == 0);
 
-		writeEmptySpace(prevEndAddr, sect->org);
+		writeEmptySpace(out, prevEndAddr, sect->org);
 
 		prevEndAddr = sect->org + sect->size;
 
-		if (sect->size != 0)
-			fprintf(
-			    mapFile,
-			    "\tSECTION: $%04" PRIx16 "-$%04x ($%04" PRIx16 " byte%s) [\"%s\"]\n",
-			    sect->org,
-			    prevEndAddr - 1,
-			    sect->size,
-			    sect->size == 1 ? "" : "s",
-			    sect->name.c_str()
-			);
-		else
-			fprintf(
-			    mapFile,
-			    "\tSECTION: $%04" PRIx16 " (0 bytes) [\"%s\"]\n",
-			    sect->org,
-			    sect->name.c_str()
-			);
+		out.append("\tSECTION: $");
+		appendHex(out, sect->org, 4);
+		if (sect->size != 0) {
+			// "\tSECTION: $%04x-$%04x ($%04x byte%s) [\"%s\"]\n"
+			out.append("-$");
+			appendHex(out, prevEndAddr - 1, 4);
+			out.append(" ($");
+			appendHex(out, sect->size, 4);
+			out.push_back(' ');
+			appendBytes(out, sect->size);
+			out.append(") [\"");
+		} else {
+			// "\tSECTION: $%04x (0 bytes) [\"%s\"]\n"
+			out.append(" (0 bytes) [\"");
+		}
+		out.append(sect->name);
+		out.append("\"]\n");
 
 		if (!noSymInMap) {
 			// Also print symbols in the following "pieces"
 			for (uint16_t org = sect->org; sect; sect = sect->nextu.get()) {
-				for (Symbol *sym : sect->symbols)
-					// Space matches "\tSECTION: $xxxx ..."
-					fprintf(
-					    mapFile,
-					    "\t         $%04" PRIx32 " = %s\n",
-					    sym->label().offset + org,
-					    sym->name.c_str()
-					);
+				for (Symbol *sym : sect->symbols) {
+					// "\t         $%04x = %s\n"; space matches "\tSECTION: $xxxx ..."
+					out.append("\t         $");
+					appendHex(out, sym->label().offset + org, 4);
+					out.append(" = ");
+					out.append(sym->name);
+					out.push_back('\n');
+				}
 
 				if (sect->nextu) {
 					// Announce the following "piece"
 					if (sect->nextu->modifier == SECTION_UNION)
-						fprintf(mapFile, "\t         ; Next union\n");
+						out.append("\t         ; Next union\n");
 					else if (sect->nextu->modifier == SECTION_FRAGMENT)
-						fprintf(mapFile, "\t         ; Next fragment\n");
+						out.append("\t         ; Next fragment\n");
 				}
 			}
 		}
@@ -469,16 +558,52 @@ static void writeMapBank(SortedSections const &sectList, SectionType type, uint3
 	}
 
 	if (used == 0) {
-		fputs("\tEMPTY\n", mapFile);
+		out.append("\tEMPTY\n");
 	} else {
 		uint16_t bankEndAddr = sectionTypeInfo[type].startAddr + sectionTypeInfo[type].size;
 
-		writeEmptySpace(prevEndAddr, bankEndAddr);
+		writeEmptySpace(out, prevEndAddr, bankEndAddr);
 
 		uint16_t slack = sectionTypeInfo[type].size - used;
 
-		fprintf(mapFile, "\tTOTAL EMPTY: $%04" PRIx16 " byte%s\n", slack, slack == 1 ? "" : "s");
+		// "\tTOTAL EMPTY: $%04x byte%s\n"
+		out.append("\tTOTAL EMPTY: $");
+		appendHex(out, slack, 4);
+		out.push_back(' ');
+		appendBytes(out, slack);
+		out.push_back('\n');
+	}
+}
+
+/*
+ * Writes every bank's contents to a file, in order; banks are formatted in parallel, though
+ * @param file The file to write to
+ * @param writeBankText The function that formats a single bank's contents
+ */
+static void writeBanks(
+    FILE *file,
+    void (*writeBankText)(std::string &, SortedSections const &, SectionType, uint32_t)
+) {
+	struct BankID {
+		SectionType type;
+		uint32_t bank;
+	};
+	std::vector<BankID> banks;
+
+	for (uint8_t i = 0; i < SECTTYPE_INVALID; i++) {
+		SectionType type = typeMap[i];
+
+		for (uint32_t bank = 0; bank < sections[type].size(); bank++)
+			banks.push_back({.type = type, .bank = bank});
 	}
+
+	std::vector<std::string> texts(banks.size());
+	parallelFor(banks.size(), defaultNbThreads(), [&](size_t i) {
+		BankID const &id = banks[i];
+		writeBankText(texts[i], sections[id.type][id.bank], id.type, id.bank);
+	});
+	for (std::string const &text : texts)
+		fwrite(text.data(), 1, text.length(), file);
 }
 
 /*
@@ -553,12 +678,7 @@ static void writeSym() {
 
 	fputs("; File generated by rgblink\n", symFile);
 
-	for (uint8_t i = 0; i < SECTTYPE_INVALID; i++) {
-		SectionType type = typeMap[i];
-
-		for (uint32_t bank = 0; bank < sections[type].size(); bank++)
-			writeSymBank(sections[type][bank], type, bank);
-	}
+	writeBanks(symFile, writeSymBank);
 
 	// Output the exported numeric constants
 	static std::vector<Symbol *> constants; // `static` so `sym_ForEach` callback can see it
@@ -596,16 +716,11 @@ static void writeMap() {
 	Defer closeMapFile{[&] { fclose(mapFile); }};
 
 	writeMapSummary();
-
-	for (uint8_t i = 0; i < SECTTYPE_INVALID; i++) {
-		SectionType type = typeMap[i];
-
-		for (uint32_t bank = 0; bank < sections[type].size(); bank++)
-			writeMapBank(sections[type][bank], type, bank);
-	}
+	writeBanks(mapFile, writeMapBank);
 }
 
 void out_WriteFiles() {
+	sortSections();
 	writeROM();
 	writeSym();
 	writeMap();
@@ -4,12 +4,17 @@
 
 #include <deque>
 #include <inttypes.h>
+#include <stdarg.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
-#include "helpers.hpp" // assume, clz, ctz
+#include "helpers.hpp" // assume, clz, ctz, unreachable_
 #include "linkdefs.hpp"
 #include "opmath.hpp"
+#include "parallel.hpp"
 
 #include "link/main.hpp"
 #include "link/section.hpp"
@@ -17,28 +22,103 @@
 
 std::deque<Assertion> assertions;
 
+// Assertions and sections are evaluated in parallel, but their diagnostics are printed afterwards
+// in the order that they would have been evaluated in, so that the output is deterministic. Thus,
+// while evaluating, diagnostics are logged, to be printed once all threads are done.
+enum PatchDiagKind {
+	DIAG_VERBOSE, // `verbosePrint`
+	DIAG_WARNING, // `warning`
+	DIAG_ERROR,   // `error`
+	DIAG_FATAL,   // `fatal`
+	DIAG_ALIASES, // `sym_DumpLocalAliasedSymbols`, with the symbol's name as the message
+};
+
+struct PatchDiagnostic {
+	PatchDiagKind kind;
+	FileStackNode const *where;
+	uint32_t lineNo;
+	std::string message;
+};
+
+// The diagnostics of a single assertion or section
+struct DiagLog {
+	std::vector<PatchDiagnostic> diags;
+	bool isFatal = false; // Once set, nothing else gets logged, and evaluation should stop
+	uint64_t nbRPNOps = 0;
+};
+
+static thread_local DiagLog *curLog; // The log of what this thread is evaluating
+
+[[gnu::format(printf, 4, 5)]] static void
+    logDiag(PatchDiagKind kind, FileStackNode const *where, uint32_t lineNo, char const *fmt, ...) {
+	if ((kind == DIAG_VERBOSE && !beVerbose) || curLog->isFatal)
+		return;
+
+	va_list args, argsCopy;
+	va_start(args, fmt);
+	va_copy(argsCopy, args);
+	std::string message(vsnprintf(nullptr, 0, fmt, args), '\0');
+	vsnprintf(message.data(), message.length() + 1, fmt, argsCopy);
+	va_end(argsCopy);
+	va_end(args);
+
+	curLog->diags.push_back(
+	    {.kind = kind, .where = where, .lineNo = lineNo, .message = std::move(message)}
+	);
+	if (kind == DIAG_FATAL)
+		curLog->isFatal = true;
+}
+
+uint64_t nbRPNOpsEvaluated = 0;
+
+static void printDiags(DiagLog const &log) {
+	nbRPNOpsEvaluated += log.nbRPNOps;
+	for (PatchDiagnostic const &diag : log.diags) {
+		switch (diag.kind) {
+		case DIAG_VERBOSE:
+			verbosePrint("%s", diag.message.c_str());
+			break;
+		case DIAG_WARNING:
+			warning(diag.where, diag.lineNo, "%s", diag.message.c_str());
+			break;
+		case DIAG_ERROR:
+			error(diag.where, diag.lineNo, "%s", diag.message.c_str());
+			break;
+		case DIAG_FATAL:
+			fatal(diag.where, diag.lineNo, "%s", diag.message.c_str());
+			unreachable_();
+		case DIAG_ALIASES:
+			sym_DumpLocalAliasedSymbols(diag.message);
+			break;
+		}
+	}
+}
+
 struct RPNStackEntry {
 	int32_t value;
 	bool errorFlag; // Whether the value is a placeholder inserted for error recovery
 };
 
-std::deque<RPNStackEntry> rpnStack;
+// Only ever grows, so that evaluating an expression does not allocate
+static thread_local std::vector<RPNStackEntry> rpnStack;
+static thread_local size_t rpnStackSize;
 
 static void pushRPN(int32_t value, bool comesFromError) {
-	rpnStack.push_front({.value = value, .errorFlag = comesFromError});
+	rpnStack[rpnStackSize++] = {.value = value, .errorFlag = comesFromError};
 }
 
 // This flag tracks whether the RPN op that is currently being evaluated
 // has popped any values with the error flag set.
-static bool isError = false;
+static thread_local bool isError = false;
 
 static int32_t popRPN(Patch const &patch) {
-	if (rpnStack.empty())
-		fatal(patch.src, patch.lineNo, "Internal error, RPN stack empty");
+	if (rpnStackSize == 0) {
+		logDiag(DIAG_FATAL, patch.src, patch.lineNo, "Internal error, RPN stack empty");
+		return 0;
+	}
 
-	RPNStackEntry entry = rpnStack.front();
+	RPNStackEntry entry = rpnStack[--rpnStackSize];
 
-	rpnStack.pop_front();
 	isError |= entry.errorFlag;
 	return entry.value;
 }
@@ -46,42 +126,86 @@ static int32_t popRPN(Patch const &patch) {
 // RPN operators
 
 static uint32_t getRPNByte(uint8_t const *&expression, int32_t &size, Patch const &patch) {
-	if (!size--)
-		fatal(patch.src, patch.lineNo, "Internal error, RPN expression overread");
+	if (size == 0) {
+		logDiag(DIAG_FATAL, patch.src, patch.lineNo, "Internal error, RPN expression overread");
+		return 0; // Reading a section name stops here, and so does the evaluation loop
+	}
 
+	size--;
 	return *expression++;
 }
 
-static Symbol const *getSymbol(std::vector<Symbol> const &symbolList, uint32_t index) {
-	assume(index != (uint32_t)-1); // PC needs to be handled specially, not here
-	Symbol const &symbol = symbolList[index];
+// The symbols referenced by each object file's symbol IDs, with imports already looked up
+static std::unordered_map<std::vector<Symbol> const *, std::vector<Symbol const *>> fileSymbolRefs;
+
+static void resolveFileSymbols(std::vector<Symbol> const &fileSymbols) {
+	auto [search, inserted] = fileSymbolRefs.try_emplace(&fileSymbols);
+	if (!inserted)
+		return;
+
+	std::vector<Symbol const *> &symbolRefs = search->second;
+	symbolRefs.reserve(fileSymbols.size());
+	for (Symbol const &symbol : fileSymbols)
+		// If the symbol is defined elsewhere...
+		symbolRefs.push_back(symbol.type == SYMTYPE_IMPORT ? sym_GetSymbol(symbol.name) : &symbol);
+}
 
-	// If the symbol is defined elsewhere...
-	if (symbol.type == SYMTYPE_IMPORT)
-		return sym_GetSymbol(symbol.name);
+static std::vector<Symbol const *> const &getSymbolRefs(std::vector<Symbol> const &fileSymbols) {
+	auto search = fileSymbolRefs.find(&fileSymbols);
 
-	return &symbol;
+	assume(search != fileSymbolRefs.end()); // `patch_ResolveSymbols` must have been called
+	return search->second;
+}
+
+static void resolveSectionSymbols(Section &section) {
+	if (!sect_HasData(section.type))
+		return;
+
+	for (Section *component = &section; component; component = component->nextu.get())
+		resolveFileSymbols(*component->fileSymbols);
+}
+
+void patch_ResolveSymbols() {
+	verbosePrint("Resolving symbol references...\n");
+
+	for (Assertion const &assert : assertions)
+		resolveFileSymbols(*assert.fileSymbols);
+	sect_ForEach(resolveSectionSymbols);
+}
+
+static Symbol const *getSymbol(std::vector<Symbol const *> const &symbolRefs, uint32_t index) {
+	assume(index != (uint32_t)-1); // PC needs to be handled specially, not here
+	return symbolRefs[index];
 }
 
 /*
  * Compute a patch's value from its RPN string.
  * @param patch The patch to compute the value of
- * @param section The section the patch is contained in
+ * @param fileSymbols The symbols of the object file that the patch comes from
+ * @param symbolRefs What each of those symbols refers to, as computed by `resolveFileSymbols`
  * @return The patch's value
  * @return isError Set if an error occurred during evaluation, and further
  *                 errors caused by the value should be suppressed.
  */
-static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fileSymbols) {
+static int32_t computeRPNExpr(
+    Patch const &patch,
+    std::vector<Symbol> const &fileSymbols,
+    std::vector<Symbol const *> const &symbolRefs
+) {
 	uint8_t const *expression = patch.rpnExpression.data();
 	int32_t size = (int32_t)patch.rpnExpression.size();
 
-	rpnStack.clear();
+	// Each command pushes at most one value, and takes up at least one byte
+	if (rpnStack.size() < patch.rpnExpression.size())
+		rpnStack.resize(patch.rpnExpression.size());
+	rpnStackSize = 0;
 
 	while (size > 0) {
 		RPNCommand command = (RPNCommand)getRPNByte(expression, size, patch);
 		int32_t value;
 
 		isError = false;
+		curLog->nbRPNOps++;
 
 		// Be VERY careful with two `popRPN` in the same expression.
 		// C++ does not guarantee order of evaluation of operands!
@@ -102,7 +226,7 @@ static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fil
 			value = popRPN(patch);
 			if (value == 0) {
 				if (!isError)
-					error(patch.src, patch.lineNo, "Division by 0");
+					logDiag(DIAG_ERROR, patch.src, patch.lineNo, "Division by 0");
 				isError = true;
 				popRPN(patch);
 				value = INT32_MAX;
@@ -114,7 +238,7 @@ static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fil
 			value = popRPN(patch);
 			if (value == 0) {
 				if (!isError)
-					error(patch.src, patch.lineNo, "Modulo by 0");
+					logDiag(DIAG_ERROR, patch.src, patch.lineNo, "Modulo by 0");
 				isError = true;
 				popRPN(patch);
 				value = 0;
@@ -129,7 +253,7 @@ static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fil
 			value = popRPN(patch);
 			if (value < 0) {
 				if (!isError)
-					error(patch.src, patch.lineNo, "Exponent by negative");
+					logDiag(DIAG_ERROR, patch.src, patch.lineNo, "Exponent by negative");
 				isError = true;
 				popRPN(patch);
 				value = 0;
@@ -219,9 +343,12 @@ static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fil
 			value = 0;
 			for (uint8_t shift = 0; shift < 32; shift += 8)
 				value |= getRPNByte(expression, size, patch) << shift;
+			if (curLog->isFatal) // The symbol ID was only partially read
+				return 0;
 
-			if (Symbol const *symbol = getSymbol(fileSymbols, value); !symbol) {
-				error(
+			if (Symbol const *symbol = getSymbol(symbolRefs, value); !symbol) {
+				logDiag(
+				    DIAG_ERROR,
 				    patch.src,
 				    patch.lineNo,
 				    "Requested BANK() of symbol \"%s\", which was not found",
@@ -232,7 +359,8 @@ static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fil
 			} else if (symbol->data.holds<Label>()) {
 				value = symbol->data.get<Label>().section->bank;
 			} else {
-				error(
+				logDiag(
+				    DIAG_ERROR,
 				    patch.src,
 				    patch.lineNo,
 				    "Requested BANK() of non-label symbol \"%s\"",
@@ -245,13 +373,16 @@ static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fil
 
 		case RPN_BANK_SECT: {
 			// `expression` is not guaranteed to be '\0'-terminated. If it is not,
-			// `getRPNByte` will have a fatal internal error.
+			// `getRPNByte` will log a fatal internal error, and evaluation must stop.
 			char const *name = (char const *)expression;
 			while (getRPNByte(expression, size, patch))
 				;
+			if (curLog->isFatal)
+				return 0;
 
 			if (Section const *sect = sect_GetSection(name); !sect) {
-				error(
+				logDiag(
+				    DIAG_ERROR,
 				    patch.src,
 				    patch.lineNo,
 				    "Requested BANK() of section \"%s\", which was not found",
@@ -267,7 +398,7 @@ static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fil
 
 		case RPN_BANK_SELF:
 			if (!patch.pcSection) {
-				error(patch.src, patch.lineNo, "PC has no bank outside of a section");
+				logDiag(DIAG_ERROR, patch.src, patch.lineNo, "PC has no bank outside of a section");
 				isError = true;
 				value = 1;
 			} else {
@@ -280,9 +411,12 @@ static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fil
 			char const *name = (char const *)expression;
 			while (getRPNByte(expression, size, patch))
 				;
+			if (curLog->isFatal)
+				return 0;
 
 			if (Section const *sect = sect_GetSection(name); !sect) {
-				error(
+				logDiag(
+				    DIAG_ERROR,
 				    patch.src,
 				    patch.lineNo,
 				    "Requested SIZEOF() of section \"%s\", which was not found",
@@ -301,9 +435,12 @@ static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fil
 			char const *name = (char const *)expression;
 			while (getRPNByte(expression, size, patch))
 				;
+			if (curLog->isFatal)
+				return 0;
 
 			if (Section const *sect = sect_GetSection(name); !sect) {
-				error(
+				logDiag(
+				    DIAG_ERROR,
 				    patch.src,
 				    patch.lineNo,
 				    "Requested STARTOF() of section \"%s\", which was not found",
@@ -321,7 +458,12 @@ static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fil
 		case RPN_SIZEOF_SECTTYPE:
 			value = getRPNByte(expression, size, patch);
 			if (value < 0 || value >= SECTTYPE_INVALID) {
-				error(patch.src, patch.lineNo, "Requested SIZEOF() an invalid section type");
+				logDiag(
+				    DIAG_ERROR,
+				    patch.src,
+				    patch.lineNo,
+				    "Requested SIZEOF() an invalid section type"
+				);
 				isError = true;
 				value = 0;
 			} else {
@@ -332,7 +474,12 @@ static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fil
 		case RPN_STARTOF_SECTTYPE:
 			value = getRPNByte(expression, size, patch);
 			if (value < 0 || value >= SECTTYPE_INVALID) {
-				error(patch.src, patch.lineNo, "Requested STARTOF() an invalid section type");
+				logDiag(
+				    DIAG_ERROR,
+				    patch.src,
+				    patch.lineNo,
+				    "Requested STARTOF() an invalid section type"
+				);
 				isError = true;
 				value = 0;
 			} else {
@@ -343,7 +490,13 @@ static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fil
 		case RPN_HRAM:
 			value = popRPN(patch);
 			if (!isError && (value < 0 || (value > 0xFF && value < 0xFF00) || value > 0xFFFF)) {
-				error(patch.src, patch.lineNo, "Value %" PRId32 " is not in HRAM range", value);
+				logDiag(
+				    DIAG_ERROR,
+				    patch.src,
+				    patch.lineNo,
+				    "Value %" PRId32 " is not in HRAM range",
+				    value
+				);
 				isError = true;
 			}
 			value &= 0xFF;
@@ -355,7 +508,13 @@ static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fil
 			// They can be easily checked with a bitmask
 			if (value & ~0x38) {
 				if (!isError)
-					error(patch.src, patch.lineNo, "Value %" PRId32 " is not a RST vector", value);
+					logDiag(
+					    DIAG_ERROR,
+					    patch.src,
+					    patch.lineNo,
+					    "Value %" PRId32 " is not a RST vector",
+					    value
+					);
 				isError = true;
 			}
 			value |= 0xC7;
@@ -371,24 +530,32 @@ static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fil
 			value = 0;
 			for (uint8_t shift = 0; shift < 32; shift += 8)
 				value |= getRPNByte(expression, size, patch) << shift;
+			if (curLog->isFatal) // The symbol ID was only partially read
+				return 0;
 
 			if (value == -1) { // PC
 				if (!patch.pcSection) {
-					error(patch.src, patch.lineNo, "PC has no value outside of a section");
+					logDiag(
+					    DIAG_ERROR,
+					    patch.src,
+					    patch.lineNo,
+					    "PC has no value outside of a section"
+					);
 					value = 0;
 					isError = true;
 				} else {
 					value = patch.pcOffset + patch.pcSection->org;
 				}
 			} else {
-				if (Symbol const *symbol = getSymbol(fileSymbols, value); !symbol) {
-					error(
+				if (Symbol const *symbol = getSymbol(symbolRefs, value); !symbol) {
+					logDiag(
+					    DIAG_ERROR,
 					    patch.src,
 					    patch.lineNo,
 					    "Unknown symbol \"%s\"",
 					    fileSymbols[value].name.c_str()
 					);
-					sym_DumpLocalAliasedSymbols(fileSymbols[value].name);
+					logDiag(DIAG_ALIASES, nullptr, 0, "%s", fileSymbols[value].name.c_str());
 					isError = true;
 				} else if (symbol->data.holds<Label>()) {
 					Label const &label = symbol->data.get<Label>();
@@ -403,69 +570,97 @@ static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fil
 		pushRPN(value, isError);
 	}
 
-	if (rpnStack.size() > 1)
-		error(patch.src, patch.lineNo, "RPN stack has %zu entries on exit, not 1", rpnStack.size());
+	if (rpnStackSize > 1)
+		logDiag(
+		    DIAG_ERROR,
+		    patch.src,
+		    patch.lineNo,
+		    "RPN stack has %zu entries on exit, not 1",
+		    rpnStackSize
+		);
 
 	isError = false;
 	return popRPN(patch);
 }
 
-void patch_CheckAssertions() {
-	verbosePrint("Checking assertions...\n");
+static void checkAssertion(Assertion const &assert) {
+	int32_t value =
+	    computeRPNExpr(assert.patch, *assert.fileSymbols, getSymbolRefs(*assert.fileSymbols));
+	AssertionType type = (AssertionType)assert.patch.type;
 
-	for (Assertion &assert : assertions) {
-		int32_t value = computeRPNExpr(assert.patch, *assert.fileSymbols);
-		AssertionType type = (AssertionType)assert.patch.type;
-
-		if (!isError && !value) {
-			switch (type) {
-			case ASSERT_FATAL:
-				fatal(
-				    assert.patch.src,
-				    assert.patch.lineNo,
-				    "%s",
-				    !assert.message.empty() ? assert.message.c_str() : "assert failure"
-				);
-			case ASSERT_ERROR:
-				error(
-				    assert.patch.src,
-				    assert.patch.lineNo,
-				    "%s",
-				    !assert.message.empty() ? assert.message.c_str() : "assert failure"
-				);
-				break;
-			case ASSERT_WARN:
-				warning(
-				    assert.patch.src,
-				    assert.patch.lineNo,
-				    "%s",
-				    !assert.message.empty() ? assert.message.c_str() : "assert failure"
-				);
-				break;
-			}
-		} else if (isError && type == ASSERT_FATAL) {
-			fatal(
+	if (curLog->isFatal)
+		return;
+
+	if (!isError && !value) {
+		switch (type) {
+		case ASSERT_FATAL:
+			logDiag(
+			    DIAG_FATAL,
+			    assert.patch.src,
+			    assert.patch.lineNo,
+			    "%s",
+			    !assert.message.empty() ? assert.message.c_str() : "assert failure"
+			);
+			break;
+		case ASSERT_ERROR:
+			logDiag(
+			    DIAG_ERROR,
 			    assert.patch.src,
 			    assert.patch.lineNo,
-			    "Failed to evaluate assertion%s%s",
-			    !assert.message.empty() ? ": " : "",
-			    assert.message.c_str()
+			    "%s",
+			    !assert.message.empty() ? assert.message.c_str() : "assert failure"
 			);
+			break;
+		case ASSERT_WARN:
+			logDiag(
+			    DIAG_WARNING,
+			    assert.patch.src,
+			    assert.patch.lineNo,
+			    "%s",
+			    !assert.message.empty() ? assert.message.c_str() : "assert failure"
+			);
+			break;
 		}
+	} else if (isError && type == ASSERT_FATAL) {
+		logDiag(
+		    DIAG_FATAL,
+		    assert.patch.src,
+		    assert.patch.lineNo,
+		    "Failed to evaluate assertion%s%s",
+		    !assert.message.empty() ? ": " : "",
+		    assert.message.c_str()
+		);
 	}
 }
 
+void patch_CheckAssertions() {
+	verbosePrint("Checking assertions...\n");
+
+	std::vector<DiagLog> logs(assertions.size());
+	parallelFor(assertions.size(), defaultNbThreads(), [&](size_t i) {
+		curLog = &logs[i];
+		checkAssertion(assertions[i]);
+	});
+	for (DiagLog const &log : logs)
+		printDiags(log);
+}
+
 /*
  * Applies all of a section's patches
  * @param section The section component to patch
  * @param dataSection The section to patch
  */
 static void applyFilePatches(Section &section, Section &dataSection) {
-	verbosePrint("Patching section \"%s\"...\n", section.name.c_str());
+	logDiag(DIAG_VERBOSE, nullptr, 0, "Patching section \"%s\"...\n", section.name.c_str());
+	std::vector<Symbol const *> const &symbolRefs = getSymbolRefs(*section.fileSymbols);
+
 	for (Patch &patch : section.patches) {
-		int32_t value = computeRPNExpr(patch, *section.fileSymbols);
+		int32_t value = computeRPNExpr(patch, *section.fileSymbols, symbolRefs);
 		uint16_t offset = patch.offset + section.offset;
 
+		if (curLog->isFatal)
+			return;
+
 		struct {
 			uint8_t size;
 			int32_t min;
@@ -479,7 +674,8 @@ static void applyFilePatches(Section &section, Section &dataSection) {
 		auto const &type = types[patch.type];
 
 		if (dataSection.data.size() < offset + type.size) {
-			error(
+			logDiag(
+			    DIAG_ERROR,
 			    patch.src,
 			    patch.lineNo,
 			    "Patch would write %zu bytes past the end of section \"%s\" (%zu bytes long)",
@@ -494,7 +690,8 @@ static void applyFilePatches(Section &section, Section &dataSection) {
 			int16_t jumpOffset = value - address;
 
 			if (!isError && (jumpOffset < -128 || jumpOffset > 127))
-				error(
+				logDiag(
+				    DIAG_ERROR,
 				    patch.src,
 				    patch.lineNo,
 				    "jr target must be between -128 and 127 bytes away, not %" PRId16
@@ -505,7 +702,8 @@ static void applyFilePatches(Section &section, Section &dataSection) {
 		} else {
 			// Patch a certain number of bytes
 			if (!isError && (value < type.min || value > type.max))
-				error(
+				logDiag(
+				    DIAG_ERROR,
 				    patch.src,
 				    patch.lineNo,
 				    "Value %" PRId32 "%s is not %u-bit",
@@ -526,13 +724,27 @@ static void applyFilePatches(Section &section, Section &dataSection) {
  * @param section The section to patch
  */
 static void applyPatches(Section &section) {
-	if (!sect_HasData(section.type))
-		return;
-
 	for (Section *component = &section; component; component = component->nextu.get())
 		applyFilePatches(*component, section);
 }
 
+// Each section only gets written to by its own patches, so sections can be patched in parallel;
+// however, a union's components may overlap each other, so they are patched one after the other
+static std::vector<Section *> dataSections;
+
+static void collectDataSection(Section &section) {
+	if (sect_HasData(section.type))
+		dataSections.push_back(&section);
+}
+
 void patch_ApplyPatches() {
-	sect_ForEach(applyPatches);
+	sect_ForEach(collectDataSection);
+
+	std::vector<DiagLog> logs(dataSections.size());
+	parallelFor(dataSections.size(), defaultNbThreads(), [&](size_t i) {
+		curLog = &logs[i];
+		applyPatches(*dataSections[i]);
+	});
+	for (DiagLog const &log : logs)
+		printDiags(log);
 }
@@ -2,12 +2,13 @@
 
 #include "link/sdas_obj.hpp"
 
-#include <ctype.h>
 #include <inttypes.h>
 #include <memory>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <tuple>
+#include <vector>
 
 #include "helpers.hpp" // assume
 #include "linkdefs.hpp"
@@ -24,67 +25,128 @@ enum NumberType {
 	OCT = 8,  // Q
 };
 
-static void consumeLF(FileStackNode const &where, uint32_t lineNo, FILE *file) {
-	if (getc(file) != '\n')
-		fatal(&where, lineNo, "Bad line ending (CR without LF)");
-}
-
-static char const *delim = " \f\n\r\t\v"; // Whitespace according to the C and POSIX locales
+// Reads a SDAS object file in large chunks, handing out lines that are terminated in place
+class LineReader {
+	FILE *file;
+	std::vector<char> buffer; // Always has a spare byte past `end`, to terminate the last line
+	size_t lineStart = 0;     // Data before this has been handed out already, and can be discarded
+	size_t pos = 0;           // The next character to be read
+	size_t end = 0;           // The end of the data read so far
+
+	bool refill() {
+		if (lineStart != 0) {
+			memmove(buffer.data(), &buffer[lineStart], end - lineStart);
+			pos -= lineStart;
+			end -= lineStart;
+			lineStart = 0;
+		}
+		// A line longer than the buffer makes it grow
+		if (end == buffer.size() - 1)
+			buffer.resize(buffer.size() * 2);
 
-static int
-    nextLine(std::vector<char> &lineBuf, uint32_t &lineNo, FileStackNode const &where, FILE *file) {
-retry:
-	++lineNo;
-	int firstChar = getc(file);
-	lineBuf.clear();
+		size_t nbRead = fread(&buffer[end], 1, buffer.size() - 1 - end, file);
+		end += nbRead;
+		return nbRead != 0;
+	}
 
-	switch (firstChar) {
-	case EOF:
-		return EOF;
-	case ';':
-		// Discard comment line
-		// TODO: if `;!FILE [...]` on the first line (`lineNo`), return it
-		do {
-			firstChar = getc(file);
-		} while (firstChar != EOF && firstChar != '\r' && firstChar != '\n');
-		[[fallthrough]];
-	case '\r':
-		if (firstChar == '\r' && getc(file) != '\n')
-			consumeLF(where, lineNo, file);
-		[[fallthrough]];
-	case '\n':
-		goto retry;
+	int getChar() {
+		if (pos == end && !refill())
+			return EOF;
+		return (uint8_t)buffer[pos++];
 	}
 
-	for (;;) {
-		int c = getc(file);
+	void consumeLF(FileStackNode const &where, uint32_t lineNo) {
+		if (getChar() != '\n')
+			fatal(&where, lineNo, "Bad line ending (CR without LF)");
+	}
 
-		switch (c) {
+public:
+	explicit LineReader(FILE *file_) : file(file_), buffer(1 << 16) {}
+
+	/*
+	 * Reads the next line that is neither empty nor a comment.
+	 * @param line Set to the line's contents, past its type; valid until the next call
+	 * @return The line's type (its first character), or `EOF` if there are no more lines
+	 */
+	int nextLine(char *&line, uint32_t &lineNo, FileStackNode const &where) {
+	retry:
+		++lineNo;
+		lineStart = pos;
+		int firstChar = getChar();
+
+		switch (firstChar) {
+		case EOF:
+			return EOF;
+		case ';':
+			// Discard comment line
+			// TODO: if `;!FILE [...]` on the first line (`lineNo`), return it
+			do {
+				firstChar = getChar();
+			} while (firstChar != EOF && firstChar != '\r' && firstChar != '\n');
+			[[fallthrough]];
 		case '\r':
-			consumeLF(where, lineNo, file);
+			if (firstChar == '\r' && getChar() != '\n')
+				consumeLF(where, lineNo);
 			[[fallthrough]];
 		case '\n':
-		case EOF:
-			lineBuf.push_back('\0'); // Terminate the string (space was ensured above)
-			return firstChar;
+			goto retry;
+		}
+
+		lineStart = pos;
+		for (;;) {
+			switch (getChar()) {
+			case '\r':
+				buffer[pos - 1] = '\0';
+				consumeLF(where, lineNo); // This may move the line within the buffer
+				line = &buffer[lineStart];
+				return firstChar;
+			case '\n':
+				buffer[pos - 1] = '\0';
+				line = &buffer[lineStart];
+				return firstChar;
+			case EOF:
+				buffer[pos] = '\0'; // Terminate the string (space was ensured above)
+				line = &buffer[lineStart];
+				return firstChar;
+			}
 		}
-		lineBuf.push_back(c);
 	}
+};
+
+// Whitespace according to the C and POSIX locales
+static bool isWhitespace(char c) {
+	return c == ' ' || c == '\f' || c == '\n' || c == '\r' || c == '\t' || c == '\v';
+}
+
+// Splits a line into tokens in place, like `strtok`; returns `nullptr` once there are none left
+static char *nextToken(char *&ptr) {
+	while (isWhitespace(*ptr))
+		++ptr;
+	if (*ptr == '\0')
+		return nullptr;
+
+	char *token = ptr;
+	while (*ptr != '\0' && !isWhitespace(*ptr))
+		++ptr;
+	if (*ptr != '\0')
+		*ptr++ = '\0';
+	return token;
 }
 
 static uint32_t readNumber(char const *str, char const *&endptr, NumberType base) {
 	uint32_t res = 0;
 
-	for (;;) {
-		static char const *digits = "0123456789ABCDEF";
-		char const *ptr = strchr(digits, toupper(*str));
+	for (;; ++str) {
+		uint8_t digit = *str >= '0' && *str <= '9'   ? *str - '0'
+		                : *str >= 'A' && *str <= 'F' ? *str - 'A' + 10
+		                : *str >= 'a' && *str <= 'f' ? *str - 'a' + 10
+		                                             : UINT8_MAX;
 
-		if (!ptr || ptr - digits >= base) {
+		if (digit >= base) {
 			endptr = str;
 			return res;
 		}
-		++str;
-		res = res * base + (ptr - digits);
+		res = res * base + digit;
 	}
 }
 
@@ -136,25 +198,26 @@ enum RelocFlags {
 };
 
 void sdobj_ReadFile(FileStackNode const &where, FILE *file, std::vector<Symbol> &fileSymbols) {
-	std::vector<char> line;
-	line.reserve(256);
+	LineReader reader(file);
+	char *line;
+	char *cursor; // Where the next token of `line` will be looked for
 	char const *token;
 
-#define getToken(ptr, ...) \
+#define getToken(...) \
 	do { \
-		token = strtok((ptr), delim); \
+		token = nextToken(cursor); \
 		if (!token) \
 			fatal(&where, lineNo, __VA_ARGS__); \
 	} while (0)
 #define expectEol(...) \
 	do { \
-		token = strtok(nullptr, delim); \
+		token = nextToken(cursor); \
 		if (token) \
 			fatal(&where, lineNo, __VA_ARGS__); \
 	} while (0)
 #define expectToken(expected, lineType) \
 	do { \
-		getToken(nullptr, "'%c' line is too short", (lineType)); \
+		getToken("'%c' line is too short", (lineType)); \
 		if (strcasecmp(token, (expected)) != 0) \
 			fatal( \
 			    &where, \
@@ -167,7 +230,7 @@ void sdobj_ReadFile(FileStackNode const &where, FILE *file, std::vector<Symbol>
 	} while (0)
 
 	uint32_t lineNo = 0;
-	int lineType = nextLine(line, lineNo, where, file);
+	int lineType = reader.nextLine(line, lineNo, where);
 	NumberType numberType;
 
 	// The first letter (thus, the line type) identifies the integer type
@@ -210,17 +273,18 @@ void sdobj_ReadFile(FileStackNode const &where, FILE *file, std::vector<Symbol>
 
 	// Header line
 
-	lineType = nextLine(line, lineNo, where, file);
+	lineType = reader.nextLine(line, lineNo, where);
 	if (lineType != 'H')
 		fatal(&where, lineNo, "Expected header line, got '%c' line", lineType);
 	// Expected format: "A areas S global symbols"
 
-	getToken(line.data(), "Empty 'H' line");
+	cursor = line;
+	getToken("Empty 'H' line");
 	uint32_t expectedNbAreas = parseNumber(where, lineNo, token, numberType);
 
 	expectToken("areas", 'H');
 
-	getToken(nullptr, "'H' line is too short");
+	getToken("'H' line is too short");
 	uint32_t expectedNbSymbols = parseNumber(where, lineNo, token, numberType);
 	fileSymbols.reserve(expectedNbSymbols);
 
@@ -240,9 +304,10 @@ void sdobj_ReadFile(FileStackNode const &where, FILE *file, std::vector<Symbol>
 	std::vector<uint8_t> data;
 
 	for (;;) {
-		lineType = nextLine(line, lineNo, where, file);
+		lineType = reader.nextLine(line, lineNo, where);
 		if (lineType == EOF)
 			break;
+		cursor = line;
 		switch (lineType) {
 		case 'M': // Module name
 		case 'O': // Assembler flags
@@ -259,7 +324,7 @@ void sdobj_ReadFile(FileStackNode const &where, FILE *file, std::vector<Symbol>
 			curSection->src = &where;
 			curSection->lineNo = lineNo;
 
-			getToken(line.data(), "'A' line is too short");
+			getToken("'A' line is too short");
 			assume(strlen(token) != 0); // This should be impossible, tokens are non-empty
 			// The following is required for fragment offsets to be reliably predicted
 			for (FileSection &entry : fileSections) {
@@ -270,7 +335,7 @@ void sdobj_ReadFile(FileStackNode const &where, FILE *file, std::vector<Symbol>
 
 			expectToken("size", 'A');
 
-			getToken(nullptr, "'A' line is too short");
+			getToken("'A' line is too short");
 
 			uint32_t tmp = parseNumber(where, lineNo, token, numberType);
 
@@ -285,7 +350,7 @@ void sdobj_ReadFile(FileStackNode const &where, FILE *file, std::vector<Symbol>
 
 			expectToken("flags", 'A');
 
-			getToken(nullptr, "'A' line is too short");
+			getToken("'A' line is too short");
 			tmp = parseNumber(where, lineNo, token, numberType);
 			if (tmp & (1 << AREA_PAGING))
 				fatal(&where, lineNo, "Internal error: paging is not supported");
@@ -303,7 +368,7 @@ void sdobj_ReadFile(FileStackNode const &where, FILE *file, std::vector<Symbol>
 
 			expectToken("addr", 'A');
 
-			getToken(nullptr, "'A' line is too short");
+			getToken("'A' line is too short");
 			tmp = parseNumber(where, lineNo, token, numberType);
 			curSection->org = tmp; // Truncation keeps the address portion only
 			curSection->bank = tmp >> 16;
@@ -361,10 +426,10 @@ void sdobj_ReadFile(FileStackNode const &where, FILE *file, std::vector<Symbol>
 			symbol.src = &where;
 			symbol.lineNo = lineNo;
 
-			getToken(line.data(), "'S' line is too short");
+			getToken("'S' line is too short");
 			symbol.name = token;
 
-			getToken(nullptr, "'S' line is too short");
+			getToken("'S' line is too short");
 
 			if (int32_t value = parseNumber(where, lineNo, &token[3], numberType);
 			    !fileSections.empty()) {
@@ -445,7 +510,7 @@ void sdobj_ReadFile(FileStackNode const &where, FILE *file, std::vector<Symbol>
 				warning(&where, lineNo, "Previous 'T' line had no 'R' line (ignored)");
 
 			data.clear();
-			for (token = strtok(line.data(), delim); token; token = strtok(nullptr, delim))
+			for (token = nextToken(cursor); token; token = nextToken(cursor))
 				data.push_back(parseByte(where, lineNo, token, numberType));
 
 			if (data.size() < ADDR_SIZE)
@@ -461,13 +526,13 @@ void sdobj_ReadFile(FileStackNode const &where, FILE *file, std::vector<Symbol>
 			}
 
 			// First two bytes are ignored
-			getToken(line.data(), "'R' line is too short");
-			getToken(nullptr, "'R' line is too short");
+			getToken("'R' line is too short");
+			getToken("'R' line is too short");
 			uint16_t areaIdx;
 
-			getToken(nullptr, "'R' line is too short");
+			getToken("'R' line is too short");
 			areaIdx = parseByte(where, lineNo, token, numberType);
-			getToken(nullptr, "'R' line is too short");
+			getToken("'R' line is too short");
 			areaIdx |= (uint16_t)parseByte(where, lineNo, token, numberType) << 8;
 			if (areaIdx >= fileSections.size())
 				fatal(
@@ -527,16 +592,16 @@ void sdobj_ReadFile(FileStackNode const &where, FILE *file, std::vector<Symbol>
 			// This all can be "translated" to RGBDS parlance by generating the
 			// appropriate RPN expression (depending on flags), plus an addition for the
 			// bytes being patched over.
-			while ((token = strtok(nullptr, delim)) != nullptr) {
+			while ((token = nextToken(cursor)) != nullptr) {
 				uint16_t flags = parseByte(where, lineNo, token, numberType);
 
 				if ((flags & 0xF0) == 0xF0) {
-					getToken(nullptr, "Incomplete relocation");
+					getToken("Incomplete relocation");
 					flags =
 					    (flags & 0x0F) | (uint16_t)parseByte(where, lineNo, token, numberType) << 4;
 				}
 
-				getToken(nullptr, "Incomplete relocation");
+				getToken("Incomplete relocation");
 				uint8_t offset = parseByte(where, lineNo, token, numberType);
 
 				if (offset < ADDR_SIZE)
@@ -556,10 +621,10 @@ void sdobj_ReadFile(FileStackNode const &where, FILE *file, std::vector<Symbol>
 					    data.size()
 					);
 
-				getToken(nullptr, "Incomplete relocation");
+				getToken("Incomplete relocation");
 				uint16_t idx = parseByte(where, lineNo, token, numberType);
 
-				getToken(nullptr, "Incomplete relocation");
+				getToken("Incomplete relocation");
 				idx |= (uint16_t)parseByte(where, lineNo, token, numberType);
 
 				// Loudly fail on unknown flags
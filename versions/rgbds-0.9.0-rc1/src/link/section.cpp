@@ -177,15 +177,10 @@ static void mergeSections(Section &target, std::unique_ptr<Section> &&other, Sec
 		// really matter, only that offsets are properly computed
 		other->offset = target.size;
 		target.size += other->size;
-		// Normally we'd check that `sect_HasData`, but SDCC areas may be `_INVALID` here
-		if (!other->data.empty()) {
-			target.data.insert(target.data.end(), RANGE(other->data));
-			// Adjust patches' PC offsets
-			for (Patch &patch : other->patches)
-				patch.pcOffset += other->offset;
-		} else if (!target.data.empty()) {
-			assume(other->size == 0);
-		}
+		// The data itself is only copied by `sect_MergeFragmentData`, once the final size is known
+		// Adjust patches' PC offsets
+		for (Patch &patch : other->patches)
+			patch.pcOffset += other->offset;
 		break;
 
 	case SECTION_NORMAL:
@@ -234,6 +229,33 @@ void sect_AddSection(std::unique_ptr<Section> &&section) {
 	}
 }
 
+static void mergeFragmentData(Section &section) {
+	if (section.modifier != SECTION_FRAGMENT || !section.nextu)
+		return;
+
+	// Normally we'd check that `sect_HasData`, but SDCC areas may be `_INVALID` here
+	bool hasData = false;
+	for (Section const *fragment = &section; fragment; fragment = fragment->nextu.get())
+		hasData |= !fragment->data.empty();
+	if (!hasData)
+		return;
+
+	section.data.resize(section.size);
+	for (Section *fragment = section.nextu.get(); fragment; fragment = fragment->nextu.get()) {
+		if (fragment->data.empty()) {
+			assume(fragment->size == 0);
+			continue;
+		}
+		memcpy(&section.data[fragment->offset], fragment->data.data(), fragment->data.size());
+		// Only the whole section's data is used from now on
+		fragment->data = std::vector<uint8_t>();
+	}
+}
+
+void sect_MergeFragmentData() {
+	sect_ForEach(mergeFragmentData);
+}
+
 Section *sect_GetSection(std::string const &name) {
 	auto search = sectionMap.find(name);
 	return search != sectionMap.end() ? sectionList[search->second].get() : nullptr;
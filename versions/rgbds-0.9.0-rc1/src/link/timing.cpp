@@ -0,0 +1,153 @@
+/* SPDX-License-Identifier: MIT */
+
+#include "link/timing.hpp"
+
+#include <chrono>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+#ifndef _WIN32
+	#include <sys/resource.h>
+#endif
+
+#include "error.hpp"
+#include "helpers.hpp" // Defer
+
+#include "link/assign.hpp"
+#include "link/patch.hpp"
+#include "link/section.hpp"
+
+struct PhaseTimes {
+	char const *name;
+	int64_t wallTime; // In nanoseconds
+	int64_t cpuTime;  // In nanoseconds, summed over all threads
+};
+
+static char const *fileName = nullptr;
+static FILE *file = nullptr;
+static std::vector<PhaseTimes> phases;
+static std::chrono::steady_clock::time_point phaseWallStart;
+static clock_t phaseCPUStart;
+
+void timing_SetFileName(char const *path) {
+	if (fileName)
+		warnx("Overriding time report file %s", fileName);
+	fileName = path;
+}
+
+bool timing_IsEnabled() {
+	return fileName != nullptr;
+}
+
+static void endPhase() {
+	if (phases.empty())
+		return;
+
+	auto elapsed = std::chrono::steady_clock::now() - phaseWallStart;
+	PhaseTimes &phase = phases.back();
+	phase.wallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+	phase.cpuTime = (int64_t)(clock() - phaseCPUStart) * 1'000'000'000 / CLOCKS_PER_SEC;
+}
+
+void timing_OpenReport() {
+	if (!timing_IsEnabled())
+		return;
+
+	file = fopen(fileName, "w");
+	if (!file)
+		err("Failed to open time report file \"%s\"", fileName);
+}
+
+void timing_StartPhase(char const *name) {
+	if (!timing_IsEnabled())
+		return;
+
+	endPhase();
+	phases.push_back({.name = name, .wallTime = 0, .cpuTime = 0});
+	phaseWallStart = std::chrono::steady_clock::now();
+	phaseCPUStart = clock();
+}
+
+// Returns the peak resident set size in KiB, or -1 if it is not known
+static int64_t getPeakRSS() {
+#ifdef _WIN32
+	return -1;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return -1;
+	#ifdef __APPLE__
+	return usage.ru_maxrss / 1024; // macOS reports it in bytes, not KiB
+	#else
+	return usage.ru_maxrss;
+	#endif
+#endif
+}
+
+static uint64_t nbSections;
+static uint64_t nbPatches;
+
+static void countSection(Section &section) {
+	nbSections++;
+	for (Section *component = &section; component; component = component->nextu.get())
+		nbPatches += component->patches.size();
+}
+
+void timing_WriteReport(unsigned int nbObjects) {
+	if (!timing_IsEnabled())
+		return;
+
+	endPhase();
+	sect_ForEach(countSection);
+
+	Defer closeFile{[&] { fclose(file); }};
+
+	// This is JSON, so that it can easily be compared between builds
+	int64_t totalWallTime = 0, totalCPUTime = 0;
+	fputs("{\n\t\"phases\": [", file);
+	for (size_t i = 0; i < phases.size(); i++) {
+		PhaseTimes const &phase = phases[i];
+
+		fprintf(
+		    file,
+		    "%s\n\t\t{\"name\": \"%s\", \"wall_ms\": %.3f, \"cpu_ms\": %.3f}",
+		    i == 0 ? "" : ",",
+		    phase.name,
+		    phase.wallTime / 1e6,
+		    phase.cpuTime / 1e6
+		);
+		totalWallTime += phase.wallTime;
+		totalCPUTime += phase.cpuTime;
+	}
+	fprintf(
+	    file,
+	    "\n\t],\n\t\"total\": {\"wall_ms\": %.3f, \"cpu_ms\": %.3f},\n",
+	    totalWallTime / 1e6,
+	    totalCPUTime / 1e6
+	);
+
+	if (int64_t peakRSS = getPeakRSS(); peakRSS >= 0)
+		fprintf(file, "\t\"peak_rss_kib\": %" PRId64 ",\n", peakRSS);
+	else
+		fputs("\t\"peak_rss_kib\": null,\n", file);
+
+	fprintf(
+	    file,
+	    "\t\"counters\": {\n"
+	    "\t\t\"objects\": %u,\n"
+	    "\t\t\"sections\": %" PRIu64 ",\n"
+	    "\t\t\"patches\": %" PRIu64 ",\n"
+	    "\t\t\"assertions\": %zu,\n"
+	    "\t\t\"rpn_ops\": %" PRIu64 ",\n"
+	    "\t\t\"free_space_queries\": %" PRIu64 "\n"
+	    "\t}\n}\n",
+	    nbObjects,
+	    nbSections,
+	    nbPatches,
+	    assertions.size(),
+	    nbRPNOpsEvaluated,
+	    nbFreeSpaceQueries
+	);
+}
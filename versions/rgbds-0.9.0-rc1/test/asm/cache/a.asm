@@ -0,0 +1,4 @@
+SECTION "cache", ROM0
+
+INCLUDE "b.inc"
+INCBIN "c.bin"
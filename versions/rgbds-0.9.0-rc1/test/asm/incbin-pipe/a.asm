@@ -0,0 +1,4 @@
+; A pipe can only be read once, so including it again must reuse its contents
+SECTION "Pipe", ROM0[0]
+	INCBIN "/dev/stdin", 1, 2
+	INCBIN "/dev/stdin"
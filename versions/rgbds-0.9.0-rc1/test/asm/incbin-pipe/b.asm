@@ -0,0 +1,3 @@
+; A pipe's length is known once it has been read, like a regular file's
+SECTION "Pipe", ROM0[0]
+	INCBIN "/dev/stdin", 1, 5
@@ -0,0 +1,16 @@
+; Macro args and unique IDs must be expanded anew for each call and iteration
+
+MACRO label_and_print
+	REPT 2
+.loop\@:
+		PRINTLN "\1 \2 \@"
+		dw .loop\@
+	ENDR
+	PRINTLN "\#"
+ENDM
+
+SECTION "Macro args", ROM0[0]
+Global:
+	label_and_print a, b
+	label_and_print c, d
+	label_and_print a, d
@@ -0,0 +1,17 @@
+; ELIF conditions and anonymous label references must be evaluated again on each iteration
+
+SECTION "ELIF and anonymous labels", ROM0[0]
+
+FOR i, 4
+	IF i == 0
+		PRINTLN "zero"
+	ELIF i == 1
+		PRINTLN "one"
+	ELIF i == 2
+		PRINTLN "two"
+	ELSE
+		PRINTLN "many"
+	ENDC
+:	db LOW(:-), LOW(:+)
+ENDR
+:	db LOW(:--)
@@ -0,0 +1,16 @@
+; Each iteration of a REPT body must see the EQUS definitions made by the previous one
+
+DEF word EQUS "\"first\""
+DEF n = 0
+REPT 3
+	PRINTLN "{word} ", word
+	REDEF word EQUS "\"later {d:n}\""
+	DEF n += 1
+ENDR
+
+DEF plain = 42
+REPT 3
+	PRINTLN plain
+	PURGE plain
+	DEF plain EQUS "\"now an EQUS\""
+ENDR
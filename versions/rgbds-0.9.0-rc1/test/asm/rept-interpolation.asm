@@ -0,0 +1,15 @@
+; Interpolations must be evaluated again on each iteration of a REPT body
+
+DEF n = 0
+REPT 4
+	DEF sym{d:n} = n * 2
+	PRINTLN "sym{d:n} = {d:sym{d:n}}"
+	DEF n += 1
+ENDR
+
+FOR i, 3
+	DEF name EQUS "value{d:i}"
+	DEF {name} = i
+	PRINTLN "{name} = ", {name}
+	PURGE name
+ENDR
@@ -0,0 +1,17 @@
+; Numbers whose syntax depends on OPT must be lexed again when OPT changes between iterations
+
+SECTION "OPT numbers", ROM0[0]
+
+DEF pass = 0
+REPT 2
+	IF pass == 0
+		OPT b.X, g.123, Q8
+	ELSE
+		OPT bX., g321., Q16
+	ENDC
+	db %X.X.
+	dw `3.21
+	dl 1.5
+	PRINTLN %X.X., " ", `3.21, " ", 1.5
+	DEF pass += 1
+ENDR
@@ -0,0 +1,8 @@
+; A warning emitted by a line of a REPT body must be printed on each iteration
+
+SECTION "Warnings", ROM0[0]
+
+REPT 3
+	db 300
+	dw $12345
+ENDR
@@ -167,6 +167,84 @@ for variant in '' '.pipe'; do
 	fi
 done
 
+i="cache"
+(( tests++ ))
+echo "${bold}${green}${i}...${rescolors}${resbold}"
+cachetmp="$(mktemp -d)"
+cp "$i"/* "$cachetmp"
+rgbasm="$PWD/$RGBASM"
+(
+	cd "$cachetmp" || exit 1
+	RGBASMFLAGS="-Weverything -v -c cache -o a.o"
+	# The first assembly populates the cache...
+	"$rgbasm" $RGBASMFLAGS a.asm >first.out 2>&1 && cp a.o first.o || exit 1
+	grep -q "^Cached object file" first.out || exit 1
+	# ...the second one reuses it...
+	"$rgbasm" $RGBASMFLAGS a.asm >second.out 2>&1 || exit 1
+	grep -q "^Using cached object file" second.out || exit 1
+	cmp first.o a.o || exit 1
+	# ...and changing an included file invalidates it
+	printf '\tdb 4, 5, 6\n' >b.inc
+	"$rgbasm" $RGBASMFLAGS a.asm >third.out 2>&1 || exit 1
+	grep -q "^Using cached object file" third.out && exit 1
+	! cmp -s first.o a.o
+)
+our_rc=$?
+rm -rf "$cachetmp"
+if [[ $our_rc -ne 0 ]]; then
+	echo "${bold}${red}${i} mismatch!${rescolors}${resbold}"
+	(( failed++ ))
+	rc=1
+fi
+
+i="profile"
+(( tests++ ))
+echo "${bold}${green}${i}...${rescolors}${resbold}"
+proftmp="$(mktemp -d)"
+cp macro-args-rept.asm "$proftmp"/a.asm
+(
+	cd "$proftmp" || exit 1
+	"$rgbasm" -Weverything -o plain.o a.asm >/dev/null || exit 1
+	"$rgbasm" -Weverything -t prof -o a.o a.asm >/dev/null || exit 1
+	# Both the summary and the trace must be written...
+	grep -q " macro label_and_print$" prof && grep -q " rept a.asm::" prof || exit 1
+	python3 -m json.tool prof.json >/dev/null || exit 1
+	# ...without changing the object file
+	cmp plain.o a.o
+)
+our_rc=$?
+rm -rf "$proftmp"
+if [[ $our_rc -ne 0 ]]; then
+	echo "${bold}${red}${i} mismatch!${rescolors}${resbold}"
+	(( failed++ ))
+	rc=1
+fi
+
+i="incbin-pipe"
+(( tests++ ))
+echo "${bold}${green}${i}...${rescolors}${resbold}"
+# INCBIN reads standard input, so that it is a pipe
+printf 'abc' | "$RGBASM" -Weverything -o "$o" "$i"/a.asm >"$output" 2>"$errput"
+tryDiff /dev/null "$output" out
+our_rc=$?
+tryDiff /dev/null "$errput" err
+(( our_rc = our_rc || $? ))
+if [[ $our_rc -eq 0 ]]; then
+	"$RGBLINK" -o "$gb" "$o"
+	dd if="$gb" count=1 bs=5 >"$output" 2>/dev/null
+	tryCmp "$i"/a.out.bin "$output" gb
+	(( our_rc = our_rc || $? ))
+fi
+printf 'abc' | "$RGBASM" -Weverything -o "$o" "$i"/b.asm >"$output" 2>"$errput"
+tryDiff /dev/null "$output" out
+(( our_rc = our_rc || $? ))
+tryDiff "$i"/b.err "$errput" err
+(( our_rc = our_rc || $? ))
+(( rc = rc || our_rc ))
+if [[ $our_rc -ne 0 ]]; then
+	(( failed++ ))
+fi
+
 if [[ "$failed" -eq 0 ]]; then
 	echo "${bold}${green}All ${tests} tests passed!${rescolors}${resbold}"
 else
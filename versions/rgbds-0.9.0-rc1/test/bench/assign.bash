@@ -0,0 +1,33 @@
+#!/usr/bin/env bash
+
+# Benchmarks section placement by linking many small floating, aligned, and fixed sections.
+# Usage: assign.bash [nb_sections]
+
+# shellcheck source=common.sh
+source "$(dirname "$0")/common.sh"
+
+nbSections=${1:-20000}
+
+awk -v nbSections="$nbSections" 'BEGIN {
+	srand(42)
+	for (i = 0; i < nbSections; i++) {
+		kind = rand()
+		if (kind < 0.02) {
+			# Fixed sections fragment the free space; keep them from overlapping each other
+			bank = 1 + nbFixed % 500
+			addr = 16384 + int(nbFixed / 500) % 16 * 1024 + int(rand() * 256)
+			printf "SECTION \"fixed %d\", ROMX[$%04x], BANK[%d]\n", i, addr, bank
+			nbFixed++
+		} else if (kind < 0.2) {
+			printf "SECTION \"aligned %d\", ROMX, ALIGN[%d]\n", i, 1 + int(rand() * 8)
+		} else {
+			printf "SECTION \"floating %d\", ROMX\n", i
+		}
+		printf "\tds %d, %d\n", 1 + int(rand() * 600), i % 256
+	}
+}' >"$tmpDir/sections.asm"
+
+"$RGBASM" -o "$tmpDir/sections.o" "$tmpDir/sections.asm"
+
+echo "Linking $nbSections sections..."
+time "$RGBLINK" -o "$tmpDir/sections.gb" -m "$tmpDir/sections.map" "$tmpDir/sections.o"
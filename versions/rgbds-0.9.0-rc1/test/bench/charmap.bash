@@ -0,0 +1,43 @@
+#!/usr/bin/env bash
+
+# Benchmarks `charmap_Convert` by assembling a large text corpus through several big charmaps.
+# Usage: charmap.bash [nb_mappings [nb_strings]]
+
+# shellcheck source=common.sh
+source "$(dirname "$0")/common.sh"
+
+nbMappings=${1:-4000}
+nbStrings=${2:-20000}
+
+awk -v nbMappings="$nbMappings" -v nbStrings="$nbStrings" 'BEGIN {
+	srand(42)
+	# Multi-byte mappings sharing prefixes, like kana or dictionary words
+	print "newcharmap base"
+	for (c = 32; c < 127; c++)
+		if (c != 34 && c != 92 && c != 123)
+			printf "charmap \"%c\", $%02x\n", c, c
+	for (i = 0; i < nbMappings; i++) {
+		word = ""
+		len = 2 + int(rand() * 6)
+		for (j = 0; j < len; j++)
+			word = word sprintf("%c", 97 + int(rand() * 26))
+		words[i] = word
+		printf "charmap \"<%s>\", $%02x, $%02x\n", word, i % 256, int(i / 256)
+	}
+	# Copies of the base charmap, as used for multiple languages
+	print "newcharmap english, base"
+	print "newcharmap japanese, base"
+	for (i = 0; i < nbMappings; i++)
+		printf "charmap \"~%d\", $%02x\n", i, i % 256
+	for (i = 0; i < nbStrings; i++) {
+		if (i % 200 == 0)
+			printf "SECTION \"corpus %d\", ROMX\n", i / 200
+		line = ""
+		for (j = 0; j < 8; j++)
+			line = line "<" words[int(rand() * nbMappings)] "> text "
+		printf "\tdb \"%s\"\n", line
+	}
+}' >"$tmpDir/input.asm"
+
+echo "Assembling $nbStrings strings through $nbMappings-mapping charmaps..."
+time "$RGBASM" -Wno-unmapped-char -o /dev/null "$tmpDir/input.asm"
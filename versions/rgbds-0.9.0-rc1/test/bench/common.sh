@@ -0,0 +1,17 @@
+# Setup shared by the benchmarks in this directory; source it, don't run it.
+# The tools default to the ones built at the repository root; set `RGBASM` etc. to compare others.
+
+export LC_ALL=C
+set -euo pipefail
+
+cd "$(dirname "${BASH_SOURCE[0]}")"
+
+RGBASM=${RGBASM:-../../rgbasm}
+RGBLINK=${RGBLINK:-../../rgblink}
+RGBFIX=${RGBFIX:-../../rgbfix}
+RGBGFX=${RGBGFX:-../../rgbgfx}
+
+tmpDir="$(mktemp -d)"
+# Immediate expansion is the desired behavior.
+# shellcheck disable=SC2064
+trap "rm -rf ${tmpDir@Q}" EXIT
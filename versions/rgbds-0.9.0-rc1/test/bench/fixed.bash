@@ -0,0 +1,34 @@
+#!/usr/bin/env bash
+
+# Benchmarks linking banks densely packed with fixed-address sections.
+# Usage: fixed.bash [nb_banks] [nb_sections_per_bank]
+
+# shellcheck source=common.sh
+source "$(dirname "$0")/common.sh"
+
+nbBanks=${1:-16}
+nbSectionsPerBank=${2:-2000}
+
+awk -v nbBanks="$nbBanks" -v nbSectionsPerBank="$nbSectionsPerBank" 'BEGIN {
+	srand(42)
+	stride = int(16384 / nbSectionsPerBank)
+	for (bank = 1; bank <= nbBanks; bank++) {
+		# Shuffle the slots, so that sections are not defined in address order
+		for (i = 0; i < nbSectionsPerBank; i++)
+			slot[i] = i
+		for (i = nbSectionsPerBank - 1; i > 0; i--) {
+			j = int(rand() * (i + 1))
+			tmp = slot[i]; slot[i] = slot[j]; slot[j] = tmp
+		}
+		for (i = 0; i < nbSectionsPerBank; i++) {
+			addr = 16384 + slot[i] * stride
+			printf "SECTION \"fixed %d.%d\", ROMX[$%04x], BANK[%d]\n", bank, i, addr, bank
+			printf "\tds %d, %d\n", 1 + int(rand() * stride), i % 256
+		}
+	}
+}' >"$tmpDir/fixed.asm"
+
+"$RGBASM" -o "$tmpDir/fixed.o" "$tmpDir/fixed.asm"
+
+echo "Linking $nbBanks banks of $nbSectionsPerBank fixed sections..."
+time "$RGBLINK" -o "$tmpDir/fixed.gb" -m "$tmpDir/fixed.map" "$tmpDir/fixed.o"
@@ -0,0 +1,27 @@
+#!/usr/bin/env bash
+
+# Benchmarks converting many small images, both with one RGBGFX run each and with a batch file.
+# Usage: gfx_batch.bash [nb_images]
+
+# shellcheck source=common.sh
+source "$(dirname "$0")/common.sh"
+
+nbImages=${1:-500}
+
+# Generate the images by reversing random tile data, 64 tiles each
+for ((i = 0; i < nbImages; i++)); do
+	head -c 1024 /dev/urandom >"$tmpDir/$i.2bpp"
+	"$RGBGFX" -r 8 -o "$tmpDir/$i.2bpp" "$tmpDir/$i.png"
+done
+awk -v nbImages="$nbImages" -v dir="$tmpDir" 'BEGIN {
+	for (i = 0; i < nbImages; i++)
+		printf "%s/%d.png -o %s/%d.out.2bpp -t %s/%d.tilemap\n", dir, i, dir, i, dir, i
+}' >"$tmpDir/images.batch"
+
+echo "Converting $nbImages images one at a time..."
+time while read -r -a args; do
+	"$RGBGFX" -u "${args[@]}"
+done <"$tmpDir/images.batch"
+
+echo "Converting $nbImages images with a batch file..."
+time "$RGBGFX" -u -B "$tmpDir/images.batch"
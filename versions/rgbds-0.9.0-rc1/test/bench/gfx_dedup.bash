@@ -0,0 +1,27 @@
+#!/usr/bin/env bash
+
+# Benchmarks deduplicating the tiles of a large image, whose tiles are all made of the same few rows.
+# Usage: gfx_dedup.bash [nb_tile_rows]
+
+# shellcheck source=common.sh
+source "$(dirname "$0")/common.sh"
+
+nbRows=${1:-256}
+
+# Like in real tilesets, many tiles are similar, and some are flipped versions of others
+awk -v nbTiles=$((nbRows * 256)) 'BEGIN {
+	srand(42)
+	for (i = 0; i < 4; i++)
+		rows[i] = int(rand() * 65536)
+	for (i = 0; i < nbTiles; i++) {
+		for (y = 0; y < 8; y++) {
+			row = rows[int(rand() * 4)]
+			printf "%c%c", row % 256, int(row / 256)
+		}
+	}
+}' >"$tmpDir/image.2bpp"
+"$RGBGFX" -r 256 -o "$tmpDir/image.2bpp" "$tmpDir/image.png"
+
+echo "Deduplicating a $((nbRows * 256))-tile image..."
+time "$RGBGFX" -u -m -o "$tmpDir/out.2bpp" -t "$tmpDir/out.tilemap" -a "$tmpDir/out.attrmap" \
+	"$tmpDir/image.png"
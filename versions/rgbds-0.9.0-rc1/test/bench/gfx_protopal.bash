@@ -0,0 +1,45 @@
+#!/usr/bin/env bash
+
+# Benchmarks gathering proto-palettes from a large image whose tiles use many different colors.
+# Usage: gfx_protopal.bash [nb_tile_rows]
+
+# shellcheck source=common.sh
+source "$(dirname "$0")/common.sh"
+
+nbRows=${1:-255}
+
+# 256 palettes of random colors, and 256 tiles per row each using up to 3 colors of one of them
+awk 'BEGIN {
+	srand(42)
+	for (i = 0; i < 256 * 4; i++) {
+		color = int(rand() * 32768)
+		printf "%c%c", color % 256, int(color / 256)
+	}
+}' >"$tmpDir/image.pal"
+awk -v nbTiles=$((nbRows * 256)) 'BEGIN {
+	srand(42)
+	for (i = 0; i < nbTiles; i++) {
+		for (j = 0; j < 3; j++)
+			colors[j] = int(rand() * 4)
+		for (y = 0; y < 8; y++) {
+			low = 0
+			high = 0
+			for (x = 0; x < 8; x++) {
+				color = colors[int(rand() * 3)]
+				low = low * 2 + color % 2
+				high = high * 2 + int(color / 2)
+			}
+			printf "%c%c", low, high
+		}
+	}
+}' >"$tmpDir/image.2bpp"
+awk -v nbTiles=$((nbRows * 256)) 'BEGIN {
+	srand(42)
+	for (i = 0; i < nbTiles; i++)
+		printf "%c", int(rand() * 256)
+}' >"$tmpDir/image.palmap"
+"$RGBGFX" -r 256 -n 256 -p "$tmpDir/image.pal" -q "$tmpDir/image.palmap" -o "$tmpDir/image.2bpp" \
+	"$tmpDir/image.png"
+
+echo "Converting a $((nbRows * 256))-tile image with 256 palettes..."
+time "$RGBGFX" -n 256 -u -o "$tmpDir/out.2bpp" -q "$tmpDir/out.palmap" "$tmpDir/image.png"
@@ -0,0 +1,22 @@
+#!/usr/bin/env bash
+
+# Benchmarks INCBIN by including every bank of a large binary file as a slice of its own.
+# Usage: incbin.bash [nb_banks]
+
+# shellcheck source=common.sh
+source "$(dirname "$0")/common.sh"
+
+nbBanks=${1:-512}
+
+head -c $((nbBanks * 16384)) /dev/urandom >"$tmpDir/data.bin"
+awk -v nbBanks="$nbBanks" 'BEGIN {
+	for (i = 0; i < nbBanks; i++) {
+		printf "SECTION \"bank %d\", ROMX\n", i
+		printf "\tINCBIN \"data.bin\", %d, 16384\n", i * 16384
+	}
+	print "SECTION \"whole\", ROM0"
+	print "\tINCBIN \"data.bin\", 0, 16384"
+}' >"$tmpDir/rom.asm"
+
+echo "Including $nbBanks banks of binary data..."
+time "$RGBASM" -I "$tmpDir" -o "$tmpDir/rom.o" "$tmpDir/rom.asm"
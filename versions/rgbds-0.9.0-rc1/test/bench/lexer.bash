@@ -0,0 +1,35 @@
+#!/usr/bin/env bash
+
+# Benchmarks the lexer on comment-heavy sources with large disabled `IF` blocks.
+# Usage: lexer.bash [nb_lines]
+
+# shellcheck source=common.sh
+source "$(dirname "$0")/common.sh"
+
+nbLines=${1:-200000}
+
+awk -v nbLines="$nbLines" 'BEGIN {
+	srand(42)
+	comment = "; The quick brown fox jumps over the lazy dog, and then some more words follow"
+	for (i = 0; i < nbLines; i++) {
+		if (i % 2000 == 0)
+			printf "SECTION \"code %d\", ROMX\n", i / 2000
+		kind = i % 10
+		if (kind < 3) {
+			print comment
+		} else if (kind == 3) {
+			printf "/* %s\n * %s\n */\n", comment, comment
+		} else if (kind == 4) {
+			# A disabled block, as left behind by build configuration flags
+			print "IF 0"
+			for (j = 0; j < 8; j++)
+				printf "\tld a, [hl+] %s \\\n\tcall Func%d\n", comment, j
+			print "ENDC"
+		} else {
+			printf "\tdb %d, %d %s\n", i % 256, int(rand() * 256), comment
+		}
+	}
+}' >"$tmpDir/input.asm"
+
+echo "Assembling $nbLines lines of comment-heavy source..."
+time "$RGBASM" -o /dev/null "$tmpDir/input.asm"
@@ -0,0 +1,37 @@
+#!/usr/bin/env bash
+
+# Benchmarks running MACRO and REPT bodies many times.
+# Usage: macro.bash [nb_calls]
+
+# shellcheck source=common.sh
+source "$(dirname "$0")/common.sh"
+
+nbCalls=${1:-20000}
+
+awk -v nbCalls="$nbCalls" 'BEGIN {
+	print "MACRO copy_bytes"
+	print "\tld hl, \\1 ; Lines using macro args must be lexed anew every time"
+	print "\tld de, wBuffer"
+	print "\tld c, 16"
+	print ".loop\\@"
+	print "\tld a, [hl+]"
+	print "\tld [de], a"
+	print "\tinc de"
+	print "\tdec c"
+	print "\tjr nz, .loop\\@"
+	print "\tREPT 4"
+	print "\t\tdb $12, $34 + 2 * 3, (1 << 4) | 5, LOW(wBuffer) ; Table entry"
+	print "\t\tdw wBuffer + 8, HIGH(wBuffer) * 256"
+	print "\tENDR"
+	print "ENDM"
+	print "SECTION \"wram\", WRAM0"
+	print "wBuffer:: ds 16"
+	for (i = 0; i < nbCalls; i++) {
+		if (i % 250 == 0)
+			printf "SECTION \"code %d\", ROMX\n", i / 250
+		printf "Label%d:\n\tcopy_bytes Label%d\n", i, i
+	}
+}' >"$tmpDir/input.asm"
+
+echo "Assembling $nbCalls macro calls..."
+time "$RGBASM" -o /dev/null "$tmpDir/input.asm"
@@ -0,0 +1,30 @@
+#!/usr/bin/env bash
+
+# Benchmarks map and sym file output by linking many sections full of labels.
+# Usage: map.bash [nb_labels]
+
+# shellcheck source=common.sh
+source "$(dirname "$0")/common.sh"
+
+nbLabels=${1:-400000}
+
+awk -v nbLabels="$nbLabels" 'BEGIN {
+	for (i = 0; i < nbLabels; i++) {
+		if (i % 1000 == 0)
+			printf "SECTION \"code %d\", ROMX\n", i / 1000
+		# Mostly local labels, as in typical code
+		if (i % 8 == 0)
+			printf "Routine%d::\n", i
+		else
+			printf ".loop%d::\n", i
+		printf "\tdb %d\n", i % 256
+		if (i % 50 == 0)
+			printf "DEF CONST%d EQU %d\nEXPORT CONST%d\n", i, i * 7919, i
+	}
+}' >"$tmpDir/labels.asm"
+
+"$RGBASM" -o "$tmpDir/labels.o" "$tmpDir/labels.asm"
+
+echo "Linking $nbLabels labels with map and sym files..."
+time "$RGBLINK" -o "$tmpDir/labels.gb" -m "$tmpDir/labels.map" -n "$tmpDir/labels.sym" \
+	"$tmpDir/labels.o"
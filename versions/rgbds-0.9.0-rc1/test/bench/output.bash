@@ -0,0 +1,25 @@
+#!/usr/bin/env bash
+
+# Benchmarks ROM output by linking a sparse, heavily padded 8 MiB ROM over an overlay.
+# Usage: output.bash [nb_banks]
+
+# shellcheck source=common.sh
+source "$(dirname "$0")/common.sh"
+
+nbBanks=${1:-512}
+
+awk -v nbBanks="$nbBanks" 'BEGIN {
+	print "SECTION \"header\", ROM0[$100]"
+	print "\tds 80, 0"
+	# Only every 16th bank gets a (small, fixed) section, the rest is padding
+	for (i = 1; i < nbBanks; i += 16) {
+		printf "SECTION \"bank %d\", ROMX[$%04x], BANK[%d]\n", i, 16384 + i % 4096, i
+		printf "\tds %d, %d\n", 64 + i % 512, i % 256
+	}
+}' >"$tmpDir/rom.asm"
+
+"$RGBASM" -o "$tmpDir/rom.o" "$tmpDir/rom.asm"
+head -c $((nbBanks * 16384)) /dev/zero >"$tmpDir/overlay.gb"
+
+echo "Linking a $nbBanks-bank ROM over an overlay..."
+time "$RGBLINK" -O "$tmpDir/overlay.gb" -o "$tmpDir/rom.gb" "$tmpDir/rom.o"
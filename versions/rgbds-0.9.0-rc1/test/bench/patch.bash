@@ -0,0 +1,43 @@
+#!/usr/bin/env bash
+
+# Benchmarks patching by linking many references to symbols imported from another object file.
+# Usage: patch.bash [nb_patches]
+
+# shellcheck source=common.sh
+source "$(dirname "$0")/common.sh"
+
+nbPatches=${1:-600000}
+
+nbLabels=2000
+
+awk -v nbLabels="$nbLabels" 'BEGIN {
+	for (i = 0; i < nbLabels; i++) {
+		if (i % 100 == 0)
+			printf "SECTION \"defs %d\", ROMX\n", i / 100
+		printf "Label%d::\n\tret\n", i
+	}
+}' >"$tmpDir/defs.asm"
+
+awk -v nbPatches="$nbPatches" -v nbLabels="$nbLabels" 'BEGIN {
+	srand(42)
+	for (i = 0; i < nbPatches; i++) {
+		if (i % 2000 == 0)
+			printf "SECTION \"refs %d\", ROMX\n", i / 2000
+		label = "Label" int(rand() * nbLabels)
+		kind = i % 4
+		if (kind == 0)
+			printf "\tdw %s\n", label
+		else if (kind == 1)
+			printf "\tcall %s\n", label
+		else if (kind == 2)
+			printf "\tld a, LOW(%s + 3)\n", label
+		else
+			printf "\tld a, BANK(%s)\n", label
+	}
+}' >"$tmpDir/refs.asm"
+
+"$RGBASM" -o "$tmpDir/defs.o" "$tmpDir/defs.asm"
+"$RGBASM" -o "$tmpDir/refs.o" "$tmpDir/refs.asm"
+
+echo "Linking $nbPatches patches..."
+time "$RGBLINK" -o "$tmpDir/out.gb" "$tmpDir/defs.o" "$tmpDir/refs.o"
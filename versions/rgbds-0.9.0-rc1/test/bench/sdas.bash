@@ -0,0 +1,43 @@
+#!/usr/bin/env bash
+
+# Benchmarks reading a large SDCC object file, made of many fully relocated absolute areas.
+# Usage: sdas.bash [nb_areas]
+
+# shellcheck source=common.sh
+source "$(dirname "$0")/common.sh"
+
+nbAreas=${1:-128}
+
+awk -v nbAreas="$nbAreas" 'BEGIN {
+	srand(42)
+	nbSymsPerArea = 64
+	nbLinesPerArea = 1000 # Each line holds 16 bytes, which fills 16000 of the bank`s bytes
+	print "XL3"
+	printf "H %X areas %X global symbols\n", nbAreas, nbAreas * nbSymsPerArea
+	print "M bench"
+	print "O -msm83"
+	for (area = 0; area < nbAreas; area++) {
+		bank = area + 1
+		addr = bank * 65536 + 16384
+		printf "A _BANK%d size %X flags 8 addr %X\n", area, nbLinesPerArea * 16, addr
+		for (i = 0; i < nbSymsPerArea; i++)
+			printf "S _sym_%d_%d Def%06X\n", area, i, 16384 + i * 200
+	}
+	for (area = 0; area < nbAreas; area++) {
+		for (line = 0; line < nbLinesPerArea; line++) {
+			addr = 16384 + line * 16
+			printf "T %02X %02X 00", addr % 256, int(addr / 256)
+			# Two 16-bit relocations to symbols, over bytes 1-2 and 9-10 (line offsets 4 and 12)
+			for (i = 0; i < 16; i++)
+				printf " %02X", (i % 8 == 1 || i % 8 == 2) ? 0 : int(rand() * 256)
+			printf "\n"
+			sym1 = int(rand() * 256) % (nbAreas * nbSymsPerArea)
+			sym2 = int(rand() * 256) % (nbAreas * nbSymsPerArea)
+			printf "R 00 00 %02X %02X 02 04 %02X 00 02 0C %02X 00\n", area % 256, int(area / 256), \
+			    sym1, sym2
+		}
+	}
+}' >"$tmpDir/bench.rel"
+
+echo "Linking $nbAreas SDCC areas..."
+time "$RGBLINK" -o "$tmpDir/bench.gb" "$tmpDir/bench.rel"
@@ -116,6 +116,38 @@ for (( i=0; i < 10; ++i )); do
 done
 echo "${bold}Done checking padding!${resbold}"
 
+# Check that fixing several files at once gives the same results as one at a time,
+# with the diagnostics in the same order
+echo "${bold}Checking fixing several files at once...${resbold}"
+(( tests++ ))
+our_rc=0
+multiple=(color empty verify noexist padding-larger default-input)
+mkdir single several
+for name in "${multiple[@]}"; do
+	if [[ -r "$src/$name.bin" ]]; then
+		cp "$src/$name.bin" "single/$name.gb"
+		cp "$src/$name.bin" "several/$name.gb"
+	fi
+done
+(
+	cd single || exit
+	for name in "${multiple[@]}"; do
+		"../$RGBFIX" -v -p 0 "$name.gb"
+	done
+) 2>single.err
+(cd several && "../$RGBFIX" -v -p 0 "${multiple[@]/%/.gb}") 2>several.err
+(( our_rc = $? != 1 ))
+tryDiff single.err several.err several.err
+(( our_rc = our_rc || $? ))
+for name in "${multiple[@]}"; do
+	if [[ -r "single/$name.gb" ]]; then
+		tryCmp "single/$name.gb" "several/$name.gb" "several/$name.gb"
+		(( our_rc = our_rc || $? ))
+	fi
+done
+(( rc = rc || our_rc ))
+(( failed += our_rc ))
+
 # Check that RGBFIX errors out when inputting a non-existent file...
 $RGBFIX noexist 2>out.err
 rc=$((rc || $? != 1))
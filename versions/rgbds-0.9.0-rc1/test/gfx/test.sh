@@ -4,10 +4,11 @@
 [[ -e ./randtilegen ]] || make -C ../.. test/gfx/randtilegen Q= ${CXX:+"CXX=$CXX"} || exit
 
 errtmp="$(mktemp)"
+outtmp="$(mktemp -d)"
 
 # Immediate expansion is the desired behavior.
 # shellcheck disable=SC2064
-trap "rm -f ${errtmp@Q} result.{png,1bpp,2bpp,pal,tilemap,attrmap,palmap} out*.png" EXIT
+trap "rm -rf ${errtmp@Q} ${outtmp@Q} result.{png,1bpp,2bpp,pal,tilemap,attrmap,palmap} out*.png" EXIT
 
 tests=0
 failed=0
@@ -101,6 +102,77 @@ for f in *.[12]bpp; do
 	runTest && cmp "$f" result.2bpp || failTest $?
 done
 
+# Check that a batch file converts each image the same as converting it on its own would
+outputFlags () {
+	for f_ext in o_2bpp p_pal t_tilemap a_attrmap; do
+		echo -n " -${f_ext%_*} $outtmp/$1.$2.${f_ext#*_}"
+	done
+}
+batchImages=(crop full_gpl full_hex input_tileset)
+: >"$outtmp/images.batch"
+for name in "${batchImages[@]}"; do
+	flags="$([[ -e "$name.flags" ]] && echo "@$name.flags")"
+	newTest "$RGBGFX" -u $flags "$name.png" $(outputFlags single "$name")
+	runTest || failTest $?
+	echo "$name.png $flags $(outputFlags batch "$name")" >>"$outtmp/images.batch"
+done
+newTest "$RGBGFX" -u -B "$outtmp/images.batch"
+if runTest; then
+	for name in "${batchImages[@]}"; do
+		for ext in 2bpp pal tilemap attrmap; do
+			cmp "$outtmp/single.$name.$ext" "$outtmp/batch.$name.$ext" || failTest
+		done
+	done
+else
+	failTest $?
+fi
+
+# Check that a failing conversion fails the batch, but only once the ones already started are done
+echo "crop.png @crop.flags $(outputFlags failing crop)" >"$outtmp/failing.batch"
+echo "noexist.png" >>"$outtmp/failing.batch"
+newTest "$RGBGFX" -u -B "$outtmp/failing.batch"
+runTest 2>"$errtmp"
+if [[ $? -ne 1 ]] || ! grep -q 'Conversion of "noexist.png" aborted' "$errtmp"; then
+	failTest
+fi
+for ext in 2bpp pal tilemap attrmap; do
+	cmp "$outtmp/single.crop.$ext" "$outtmp/failing.crop.$ext" || failTest
+done
+
+# Check that batch files cannot be nested
+echo "crop.png -B $outtmp/images.batch" >"$outtmp/nested.batch"
+newTest "$RGBGFX" -B "$outtmp/nested.batch"
+runTest 2>"$errtmp"
+if [[ $? -ne 1 ]] || ! grep -q 'Batch jobs cannot themselves use batch files' "$errtmp"; then
+	failTest
+fi
+
+# Check that converting an image with several threads gives the same results as with one,
+# including the same diagnostics
+for f in *.png; do
+	# Do not process outputs of other tests as test inputs themselves
+	if [[ "$f" = result.png ]]; then
+		continue
+	fi
+
+	flags="$([[ -e "${f%.png}.flags" ]] && echo "@${f%.png}.flags")"
+	for extraFlags in "" -u -m "-Z -u"; do
+		"$RGBGFX" -j 1 $flags $extraFlags "$f" $(outputFlags thread "${f%.png}") 2>"$errtmp"
+		threadRc=$?
+		newTest "$RGBGFX" -j 4 $flags $extraFlags "$f" $(outputFlags threads "${f%.png}")
+		runTest 2>"$outtmp/threads.err"
+		threadsRc=$?
+		diff -u "$errtmp" "$outtmp/threads.err" || failTest
+		if [[ $threadsRc -ne $threadRc ]]; then
+			failTest $threadsRc
+		elif [[ $threadRc -eq 0 ]]; then
+			for ext in 2bpp pal tilemap attrmap; do
+				cmp "$outtmp/thread.${f%.png}.$ext" "$outtmp/threads.${f%.png}.$ext" || failTest
+			done
+		fi
+	done
+done
+
 if [[ "$failed" -eq 0 ]]; then
 	echo "${bold}${green}All ${tests} tests passed!${rescolors}${resbold}"
 else
@@ -0,0 +1,14 @@
+SECTION "entry", ROM0[$0100]
+	jp start
+
+SECTION "header", ROM0[$0104]
+	ds $150 - $104, 0
+
+SECTION "start", ROM0
+start:
+	call _function0
+	call _function1
+	stop
+
+SECTION FRAGMENT "pointers", ROM0
+	dw _function0
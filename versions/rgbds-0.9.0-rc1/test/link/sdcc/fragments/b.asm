@@ -0,0 +1,3 @@
+SECTION FRAGMENT "pointers", ROM0
+	db $42
+	dw _function1
@@ -221,6 +221,17 @@ tryDiff "$test"/out.err "$outtemp"
 tryCmpRomSize "$gbtemp" 65536
 evaluateTest
 
+test="sdcc/fragments"
+startTest
+"$RGBASM" -o "$otemp" "$test"/a.asm
+"$RGBASM" -o "$gbtemp2" "$test"/b.asm
+continueTest
+# `empty.rel`'s `_CODE` is that area's first fragment, and it has no data
+rgblinkQuiet -o "$gbtemp" -l sdcc/good/script.link "$otemp" "$test"/empty.rel "$gbtemp2" sdcc/good/b.rel sdcc/good/c.rel 2>"$outtemp"
+tryDiff /dev/null "$outtemp"
+tryCmpRom "$test"/ref.out.bin
+evaluateTest
+
 test="sdcc/good"
 startTest
 "$RGBASM" -o "$otemp" "$test"/a.asm
@@ -343,6 +354,31 @@ rgblinkQuiet "$otemp" "$gbtemp" "$gbtemp2" "$outtemp" "$outtemp2" 2>"$outtemp3"
 tryDiff "$test"/out.err "$outtemp3"
 evaluateTest
 
+test="time-report"
+startTest
+"$RGBASM" -o "$otemp" "$test"/a.asm
+continueTest
+rgblinkQuiet -o "$gbtemp2" "$otemp"
+rgblinkQuiet -o "$gbtemp" -T "$outtemp" "$otemp"
+# Timings vary between runs, so only check the report's structure and counters
+python3 - "$outtemp" <<'EOF'
+import json, sys
+report = json.load(open(sys.argv[1]))
+assert [phase["name"] for phase in report["phases"]] == [
+	"read_objects", "sanity_checks", "resolve_symbols", "assign_sections",
+	"check_assertions", "apply_patches", "write_files",
+]
+assert report["total"].keys() == {"wall_ms", "cpu_ms"}
+assert "peak_rss_kib" in report
+assert report["counters"] == {
+	"objects": 1, "sections": 2, "patches": 3, "assertions": 1,
+	"rpn_ops": 6, "free_space_queries": 2,
+}
+EOF
+(( our_rc = our_rc || $? ))
+tryCmp "$gbtemp2" "$gbtemp"
+evaluateTest
+
 if [[ "$failed" -eq 0 ]]; then
 	echo "${bold}${green}All ${tests} tests passed!${rescolors}${resbold}"
 else
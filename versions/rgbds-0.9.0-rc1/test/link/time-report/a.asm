@@ -0,0 +1,8 @@
+SECTION "Code", ROM0
+Start:
+	jp Data
+	assert Data != Start
+
+SECTION "Data", ROMX
+Data:
+	dw Start, Data